@@ -0,0 +1,254 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      AuditCache.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Remembers recent audits by major and the courses that
+//                 count toward it, so students who have taken the same
+//                 courses (most of a year following the standard sequence)
+//                 are only audited once.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef AuditCache_hpp
+#define AuditCache_hpp
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <iostream>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include "Course.hpp"
+#include "AuditResult.hpp"
+#include "RequirementProgram.hpp"
+#include "Metrics.hpp"
+
+/* Keeps the audits of a major's students by a fingerprint of the major and the sorted ids of
+ * the completed courses its requirements mention (see RequirementProgram::courseIds) - the
+ * only things a single major audit depends on. The order of the transcript, repeated courses
+ * and courses the major does not mention all give the same fingerprint. A hit is checked
+ * against the program and ids it was made from, so two fingerprints that collide never mix
+ * up their audits.
+ * Only the audit's part of a result is kept (the required courses and categories); the
+ * student's own info, plans, eligible courses and pages of choices are never shared. The
+ * categories, which hold every choice, are shared with the results rather than copied (see
+ * AuditResult::editCategories), so a hit only copies the required courses.
+ * An audit is only kept the second time its fingerprint is seen, so a cohort of mostly
+ * different transcripts does not keep evicting audits that will never be hit.
+ * The least recently used audits are dropped once the audits kept take more than maxBytes
+ * (an estimate of their size). An audit keeps the program it was made from, and one made
+ * from a program the RequirementsCache has since replaced is never hit again, so like the
+ * other caches it is cleared when the catalog version changes.
+ * Safe to share between threads; the lock is not held while auditing.
+ */
+class AuditCache {
+
+public:
+        static const size_t DEFAULT_MAX_BYTES = 64 << 20;
+        static const size_t MAX_SEEN = 1 << 16;// fingerprints remembered before they are kept
+
+private:
+        struct Entry {
+                uint64_t fingerprint;
+                std::shared_ptr<const RequirementProgram> program;
+                std::vector<uint32_t> courses;
+                std::shared_ptr<const AuditResult> audit;
+                size_t bytes;
+        };
+
+        std::list<Entry> entries;// most recently used first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> byFingerprint;
+        std::unordered_set<uint64_t> seen;// fingerprints missed once (forgotten all at once when full)
+        size_t maxBytes, bytes;
+        std::string version;// catalog version the kept audits belong to
+        unsigned long hits, misses, evictions;
+        mutable std::mutex lock;
+
+        static uint64_t mix(uint64_t hash, uint64_t value) {
+                hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+                return hash * 0xFF51AFD7ED558CCDULL;
+        };
+
+        static uint64_t fingerprintOf(const std::string &major, const std::vector<uint32_t> &courses) {
+                uint64_t hash = mix(std::hash<std::string>()(major), courses.size());
+                for(auto it = courses.begin(); it != courses.end(); ++it) {
+                        hash = mix(hash, *it);
+                }
+                return hash;
+        };
+
+        static size_t sizeOf(const Course &course) {
+                return sizeof(Course) + course.getName().capacity();
+        };
+
+        // roughly the memory an entry holds
+        static size_t sizeOf(const Entry &entry) {
+                const AuditResult &audit = *entry.audit;
+                size_t size = sizeof(Entry) + sizeof(AuditResult) + entry.courses.capacity() * sizeof(uint32_t);
+                for(auto it = audit.requiredCompleted.begin(); it != audit.requiredCompleted.end(); ++it) {
+                        size += sizeOf(*it);
+                }
+                for(auto it = audit.requiredRemaining.begin(); it != audit.requiredRemaining.end(); ++it) {
+                        size += sizeOf(*it);
+                }
+                for(auto c = audit.getCategories().begin(); c != audit.getCategories().end(); ++c) {
+                        size += sizeof(CategoryResult) + c->name.capacity() + c->used.capacity() * sizeof(CourseKey);
+                        for(auto it = c->choices.begin(); it != c->choices.end(); ++it) {
+                                size += sizeOf(*it);
+                        }
+                }
+                return size;
+        };
+
+        // drops the least recently used audits until the rest fit (the lock is held)
+        void evict() {
+                while(bytes > maxBytes && !entries.empty()) {
+                        const Entry &last = entries.back();
+                        bytes -= last.bytes;
+                        byFingerprint.erase(last.fingerprint);
+                        entries.pop_back();
+                        ++evictions;
+                }
+        };
+
+public:
+        explicit AuditCache(size_t maxBytes = DEFAULT_MAX_BYTES) {
+                this->maxBytes = maxBytes;
+                this->bytes = 0;
+                this->hits = 0;
+                this->misses = 0;
+                this->evictions = 0;
+        };
+
+        AuditCache(const AuditCache &) = delete;
+        AuditCache &operator=(const AuditCache &) = delete;
+
+        // false if no audits are kept (a maxBytes of 0)
+        bool isEnabled() const {
+                return maxBytes > 0;
+        };
+
+        /*
+         * Audits the courses in result.completed against program like
+         * RequirementProgram::audit, reusing a kept audit of the same courses if there is one.
+         */
+        AuditResult audit(const std::shared_ptr<const RequirementProgram> &program, AuditResult result) {
+                if(!isEnabled()) {
+                        return program->audit(std::move(result));
+                }
+                static Counter &hitCount = Metrics::instance().counter("course_guide_audit_cache_hits_total",
+                                                                      "Audits answered from the audit cache");
+                static Counter &missCount = Metrics::instance().counter("course_guide_audit_cache_misses_total",
+                                                                       "Audits the audit cache did not have");
+                std::vector<uint32_t> courses = program->courseIds(result.completed);
+                uint64_t fingerprint = fingerprintOf(program->getMajor(), courses);
+                std::shared_ptr<const AuditResult> kept;
+                bool keep = false;
+                {
+                        std::lock_guard<std::mutex> guard(lock);
+                        auto found = byFingerprint.find(fingerprint);
+                        if(found != byFingerprint.end() && found->second->program == program
+                           && found->second->courses == courses) {
+                                entries.splice(entries.begin(), entries, found->second);
+                                kept = found->second->audit;
+                                ++hits;
+                        } else {
+                                ++misses;
+                                keep = seen.erase(fingerprint) != 0;
+                                if(!keep) {
+                                        if(seen.size() >= MAX_SEEN) {
+                                                seen.clear();
+                                        }
+                                        seen.insert(fingerprint);
+                                }
+                        }
+                }
+                if(kept) {
+                        hitCount.add();
+                        result.majorFound = kept->majorFound;
+                        result.requiredCompleted = kept->requiredCompleted;
+                        result.requiredRemaining = kept->requiredRemaining;
+                        result.categories = kept->categories;// shared, not copied
+                        return result;
+                }
+                missCount.add();
+
+                result = program->audit(std::move(result));
+                if(!keep) {
+                        return result;
+                }
+                std::shared_ptr<AuditResult> audit(new AuditResult());
+                audit->majorFound = result.majorFound;
+                audit->requiredCompleted = result.requiredCompleted;
+                audit->requiredRemaining = result.requiredRemaining;
+                audit->categories = result.categories;
+                Entry entry;
+                entry.fingerprint = fingerprint;
+                entry.program = program;
+                entry.courses = std::move(courses);
+                entry.audit = audit;
+                entry.bytes = sizeOf(entry);
+
+                std::lock_guard<std::mutex> guard(lock);
+                auto found = byFingerprint.find(fingerprint);
+                if(found != byFingerprint.end()) {
+                        // another thread kept the same audit meanwhile, or the fingerprints collide
+                        bytes -= found->second->bytes;
+                        entries.erase(found->second);
+                        byFingerprint.erase(found);
+                }
+                entries.push_front(std::move(entry));
+                byFingerprint[fingerprint] = entries.begin();
+                bytes += entries.front().bytes;
+                evict();
+                return result;
+        };
+
+        // drops every kept audit
+        void clear() {
+                std::lock_guard<std::mutex> guard(lock);
+                entries.clear();
+                byFingerprint.clear();
+                seen.clear();
+                bytes = 0;
+        };
+
+        /*
+         * Clears the cache if the catalog version differs from the one it was filled under.
+         * Returns true if the cache was cleared.
+         */
+        bool checkVersion(const std::string &current) {
+                std::lock_guard<std::mutex> guard(lock);
+                if(current == version) {
+                        return false;
+                }
+                version = current;
+                bool stale = !entries.empty();
+                entries.clear();
+                byFingerprint.clear();
+                seen.clear();
+                bytes = 0;
+                return stale;
+        };
+
+        size_t size() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return entries.size();
+        };
+
+        void printStats(std::ostream &out) const {
+                std::lock_guard<std::mutex> guard(lock);
+                unsigned long lookups = hits + misses;
+                out << "Audit cache: " << entries.size() << " audits kept (" << (bytes >> 10) << " of "
+                    << (maxBytes >> 10) << " KB), " << hits << " hits, " << misses << " misses ("
+                    << (lookups > 0 ? 100.0 * hits / lookups : 0.0) << "% hit rate), " << evictions
+                    << " evicted" << std::endl;
+        };
+};
+
+#endif
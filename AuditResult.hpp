@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      AuditResult.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    The outcome of auditing one student: which requirements
+//                 are met, the courses used for each, the choices left and
+//                 the credits still outstanding. A ReportWriter turns it
+//                 into text, JSON or CSV.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef AuditResult_hpp
+#define AuditResult_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+
+// the state of one option category after the audit
+struct CategoryResult {
+        static const int CREDITS_UNKNOWN = -1;
+
+        std::string name;
+        int numRequired;
+        std::vector<CourseKey> used;// completed courses used to fulfill the category
+        std::vector<Course> choices;// courses that could still be taken
+        int outstanding;// courses still needed
+        int creditsOutstanding;// fewest credits that would finish the category (or CREDITS_UNKNOWN)
+        size_t moreChoices;// choices left off the page shown (see ChoicePager)
+
+        CategoryResult() {
+                this->numRequired = 0;
+                this->outstanding = 0;
+                this->creditsOutstanding = 0;
+                this->moreChoices = 0;
+        };
+
+        bool isComplete() const {
+                return outstanding <= 0;
+        };
+
+        // sets outstanding and creditsOutstanding from numRequired, used and choices
+        void tally() {
+                outstanding = std::max(0, numRequired - (int)used.size());
+                std::vector<int> credits;
+                for(auto it = choices.begin(); it != choices.end(); ++it) {
+                        credits.push_back((*it).getCredits());
+                }
+                // the cheapest way to finish is to take the lowest credit choices
+                size_t take = std::min(credits.size(), (size_t)outstanding);
+                std::partial_sort(credits.begin(), credits.begin() + take, credits.end());
+                creditsOutstanding = 0;
+                for(size_t i = 0; i < take; ++i) {
+                        creditsOutstanding += credits[i];
+                }
+        };
+};
+
+// the courses to take each semester to finish the major (see GraduationPlanner)
+struct GraduationPlan {
+        bool made;// false if no plan was asked for
+        std::string problem;// why no plan could be made (empty if there is one)
+        int creditCap;// most credits in one semester
+        int lowerBound;// no plan can take fewer semesters
+        std::vector<std::vector<Course> > semesters;
+
+        GraduationPlan() {
+                this->made = false;
+                this->creditCap = 0;
+                this->lowerBound = 0;
+        };
+
+        bool isFeasible() const {
+                return made && problem.empty();
+        };
+
+        // true if the plan is known to take the fewest semesters possible
+        bool isOptimal() const {
+                return isFeasible() && (int)semesters.size() <= lowerBound;
+        };
+};
+
+// the audit of one student against the requirements of their major
+struct AuditResult {
+        std::string id, name, major;
+        int year;
+        std::vector<CourseKey> completed;
+        bool majorFound;// false if the major's requirements could not be loaded
+        std::vector<Course> requiredCompleted;// absolutely required courses already taken
+        std::vector<Course> requiredRemaining;// absolutely required courses still to take
+        // in audit order (Electives last) - shared by the audits of students with the same courses
+        // (see AuditCache), so use getCategories and editCategories
+        std::shared_ptr<const std::vector<CategoryResult> > categories;
+        GraduationPlan plan;// only made when asked for
+        bool eligibleListed;// false if the eligible courses were not asked for
+        std::vector<Course> eligible;// courses that count toward a requirement and can be taken now
+        std::vector<std::string> otherMajors;// the student's other majors (see MultiMajorAudit)
+        std::vector<CourseKey> shared;// completed courses that count for one of the other majors too
+
+        AuditResult() {
+                this->year = 0;
+                this->majorFound = false;
+                this->eligibleListed = false;
+        };
+
+        const std::vector<CategoryResult> &getCategories() const {
+                static const std::vector<CategoryResult> none;
+                return categories ? *categories : none;
+        };
+
+        void setCategories(std::vector<CategoryResult> results) {
+                categories = std::make_shared<std::vector<CategoryResult> >(std::move(results));
+        };
+
+        // the categories to change, copied first if another result shares them
+        std::vector<CategoryResult> &editCategories() {
+                if(!categories || categories.use_count() > 1) {
+                        setCategories(getCategories());
+                }
+                // only this result holds them and they were not made const
+                return const_cast<std::vector<CategoryResult> &>(*categories);
+        };
+
+        bool isComplete() const {
+                if(!majorFound || !requiredRemaining.empty()) {
+                        return false;
+                }
+                const std::vector<CategoryResult> &categories = getCategories();
+                for(auto it = categories.begin(); it != categories.end(); ++it) {
+                        if(!it->isComplete()) {
+                                return false;
+                        }
+                }
+                return true;
+        };
+
+        // credits still needed to graduate (remaining required courses plus the cheapest choices)
+        // or CategoryResult::CREDITS_UNKNOWN if a category's are not known
+        int creditsOutstanding() const {
+                int credits = 0;
+                for(auto it = requiredRemaining.begin(); it != requiredRemaining.end(); ++it) {
+                        credits += (*it).getCredits();
+                }
+                const std::vector<CategoryResult> &categories = getCategories();
+                for(auto it = categories.begin(); it != categories.end(); ++it) {
+                        if(it->creditsOutstanding == CategoryResult::CREDITS_UNKNOWN) {
+                                return CategoryResult::CREDITS_UNKNOWN;
+                        }
+                        credits += it->creditsOutstanding;
+                }
+                return credits;
+        };
+};
+
+#endif
@@ -0,0 +1,292 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      AuditServer.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Serves audit requests over a local Unix domain socket. A
+//                 bounded queue hands the connections to a pool of worker
+//                 threads, so whatever the workers keep warm (connections,
+//                 course data, requirements) is shared by every request.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef AuditServer_hpp
+#define AuditServer_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+// include posix headers for sockets
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* One request per connection: the client writes the request and shuts down its side of
+ * the socket (or closes it), the server writes the response and closes the connection.
+ *
+ * The accepting thread only queues connections. If the queue is full the client is told
+ * the server is busy straight away instead of waiting behind the backlog. Requests larger
+ * than MAX_REQUEST or clients that stall longer than IO_TIMEOUT_SEC are dropped so one
+ * client can not hold a worker.
+ *
+ * run() returns after stop() is called or the process gets SIGINT or SIGTERM; the
+ * requests already queued are answered first.
+ */
+class AuditServer {
+
+public:
+        // turns a request into its response (called by the workers, so it must be thread safe)
+        typedef std::function<std::string(const std::string &request)> Handler;
+
+private:
+        static const size_t MAX_REQUEST = 16 * 1024 * 1024;
+        static const int IO_TIMEOUT_SEC = 10;
+        static const int POLL_MS = 250;// how often the accept loop checks for a stop
+
+        std::string path;
+        unsigned int numWorkers;
+        size_t maxQueue;
+        Handler handler;
+        int listenFd;
+
+        std::deque<int> queue;// accepted connections waiting for a worker
+        bool stopping;
+        std::mutex lock;
+        std::condition_variable ready;
+
+        std::atomic<unsigned long> served, rejected, failed;
+        std::atomic<unsigned long long> totalMicros, maxMicros;
+
+        static volatile std::sig_atomic_t &signalled() {
+                static volatile std::sig_atomic_t flag = 0;
+                return flag;
+        };
+
+        static void onSignal(int) {
+                signalled() = 1;
+        };
+
+        // reads until the client shuts down its side (false if the client misbehaves)
+        static bool readRequest(int fd, std::string &request) {
+                char chunk[64 * 1024];
+                while(true) {
+                        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                        if(n == 0) {
+                                return true;
+                        }
+                        if(n < 0) {
+                                if(errno == EINTR) {
+                                        continue;
+                                }
+                                return false;// error or timed out
+                        }
+                        if(request.size() + n > MAX_REQUEST) {
+                                return false;
+                        }
+                        request.append(chunk, n);
+                }
+        };
+
+        static bool writeAll(int fd, const std::string &data) {
+                size_t sent = 0;
+                while(sent < data.size()) {
+                        // MSG_NOSIGNAL - a client that went away must not kill the server with SIGPIPE
+                        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                        if(n < 0) {
+                                if(errno == EINTR) {
+                                        continue;
+                                }
+                                return false;
+                        }
+                        sent += n;
+                }
+                return true;
+        };
+
+        void serve(int fd) {
+                auto start = std::chrono::steady_clock::now();
+                timeval timeout;
+                timeout.tv_sec = IO_TIMEOUT_SEC;
+                timeout.tv_usec = 0;
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+                std::string request;
+                bool ok = readRequest(fd, request);
+                if(ok) {
+                        std::string response;
+                        try {
+                                response = handler(request);
+                        }
+                        catch(std::exception &e) {
+                                response = std::string("# ERR: ") + e.what() + "\n";
+                                ok = false;
+                        }
+                        ok = writeAll(fd, response) && ok;
+                }
+                close(fd);
+
+                unsigned long long micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+                totalMicros += micros;
+                unsigned long long longest = maxMicros;
+                while(micros > longest && !maxMicros.compare_exchange_weak(longest, micros)) {
+                }
+                ++(ok ? served : failed);
+        };
+
+        void work() {
+                while(true) {
+                        int fd;
+                        {
+                                std::unique_lock<std::mutex> guard(lock);
+                                ready.wait(guard, [this]() { return stopping || !queue.empty(); });
+                                if(queue.empty()) {
+                                        return;// stopping and nothing left to answer
+                                }
+                                fd = queue.front();
+                                queue.pop_front();
+                        }
+                        serve(fd);
+                }
+        };
+
+public:
+        AuditServer(const std::string &path, unsigned int numWorkers, size_t maxQueue, Handler handler)
+                : handler(handler), served(0), rejected(0), failed(0), totalMicros(0), maxMicros(0) {
+                this->path = path;
+                this->numWorkers = std::max(1u, numWorkers);
+                this->maxQueue = std::max<size_t>(1, maxQueue);
+                this->listenFd = -1;
+                this->stopping = false;
+        };
+
+        ~AuditServer() {
+                if(listenFd >= 0) {
+                        close(listenFd);
+                        unlink(path.c_str());
+                }
+        };
+
+        AuditServer(const AuditServer &) = delete;
+        AuditServer &operator=(const AuditServer &) = delete;
+
+        /*
+         * Creates the socket file and starts listening. A socket file left behind by a server
+         * that is no longer running is replaced.
+         * Returns false and describes the problem in error if the socket can not be made.
+         */
+        bool listen(std::string &error) {
+                sockaddr_un addr;
+                std::memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                if(path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                        error = "socket path \"" + path + "\" is empty or too long";
+                        return false;
+                }
+                std::strcpy(addr.sun_path, path.c_str());
+
+                listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+                if(listenFd < 0) {
+                        error = std::string("could not create a socket: ") + std::strerror(errno);
+                        return false;
+                }
+                // a server still answering on the path must not be replaced
+                int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+                bool inUse = probe >= 0 && connect(probe, (sockaddr *)&addr, sizeof(addr)) == 0;
+                if(probe >= 0) {
+                        close(probe);
+                }
+                if(inUse) {
+                        error = "another server is already listening on " + path;
+                        close(listenFd);
+                        listenFd = -1;
+                        return false;
+                }
+                unlink(path.c_str());
+                if(bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+                        error = "could not listen on " + path + ": " + std::strerror(errno);
+                        close(listenFd);
+                        listenFd = -1;
+                        return false;
+                }
+                return true;
+        };
+
+        // accepts requests until stop() is called or the process is told to stop
+        void run() {
+                signalled() = 0;
+                std::signal(SIGINT, onSignal);
+                std::signal(SIGTERM, onSignal);
+
+                std::vector<std::thread> workers;
+                for(unsigned int i = 0; i < numWorkers; ++i) {
+                        workers.push_back(std::thread(&AuditServer::work, this));
+                }
+                while(true) {
+                        {
+                                std::lock_guard<std::mutex> guard(lock);
+                                if(stopping || signalled()) {
+                                        stopping = true;
+                                        break;
+                                }
+                        }
+                        pollfd listening;
+                        listening.fd = listenFd;
+                        listening.events = POLLIN;
+                        if(poll(&listening, 1, POLL_MS) <= 0) {
+                                continue;// timed out or interrupted - check for a stop
+                        }
+                        int fd = accept(listenFd, NULL, NULL);
+                        if(fd < 0) {
+                                continue;
+                        }
+                        std::unique_lock<std::mutex> guard(lock);
+                        if(queue.size() >= maxQueue) {
+                                guard.unlock();
+                                ++rejected;
+                                writeAll(fd, "# ERR: server busy - try again\n");
+                                close(fd);
+                                continue;
+                        }
+                        queue.push_back(fd);
+                        guard.unlock();
+                        ready.notify_one();
+                }
+                ready.notify_all();
+                for(auto it = workers.begin(); it != workers.end(); ++it) {
+                        (*it).join();
+                }
+                std::signal(SIGINT, SIG_DFL);
+                std::signal(SIGTERM, SIG_DFL);
+        };
+
+        // makes run() return once the queued requests are answered (safe from any thread)
+        void stop() {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+        };
+
+        void printStats(std::ostream &out) const {
+                unsigned long answered = served + failed;
+                out << "Server: " << served << " requests served, " << failed << " failed, "
+                    << rejected << " rejected as busy, "
+                    << (answered > 0 ? totalMicros / answered / 1000.0 : 0) << " ms avg, "
+                    << maxMicros / 1000.0 << " ms max" << std::endl;
+        };
+};
+
+#endif
@@ -0,0 +1,508 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      CatalogSnapshot.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    An offline copy of everything the audit reads from the
+//                 database (major requirements, option categories, elective
+//                 pools, prerequisites and course data) stored in one binary
+//                 file. The
+//                 file is memory mapped and read in place so audits can run
+//                 without MySQL.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CatalogSnapshot_hpp
+#define CatalogSnapshot_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "Course.hpp"
+#include "MajorRequirements.hpp"
+#include "MappedFile.hpp"
+
+/* A read only, memory mapped catalog snapshot.
+ * File layout (native byte order, every section 8 byte aligned):
+ *   Header | MajorRecord[] | CategoryRecord[] | CourseRecord[] | PrerequisiteRecord[] |
+ *   uint32 course refs[] | strings
+ * Majors are sorted by name and courses by CourseKey so both are found with a binary search.
+ * Required courses, category choices and the prerequisites of a course are runs of course
+ * refs (indices into the course records). Only courses that have prerequisites get a
+ * prerequisite record, sorted by course ref; the prerequisites are courses too. Strings are stored once and referenced by offset and length.
+ * Opening a snapshot only checks the header - nothing is parsed or copied. The name of a
+ * course is copied out the first time it is read and shared by every Course made from the
+ * record after that, so reading requirements does not allocate anything per course.
+ * Safe to share between threads once open.
+ */
+class CatalogSnapshot {
+
+public:
+        static const uint32_t FORMAT_VERSION = 3;
+
+        struct StrRef {
+                uint32_t offset, length;
+        };
+
+        struct Header {
+                char magic[8];
+                uint32_t formatVersion;
+                uint32_t numMajors, numCategories, numCourses, numPrerequisites, numRefs;
+                uint32_t stringsSize;
+                StrRef catalogVersion;
+                uint64_t majorsOffset, categoriesOffset, coursesOffset, prerequisitesOffset, refsOffset, stringsOffset;
+        };
+
+        struct MajorRecord {
+                StrRef name, listing;
+                int32_t id;
+                uint32_t firstRequired, numRequired;// run of course refs
+                uint32_t firstCategory, numCategories;// run of category records
+        };
+
+        struct CategoryRecord {
+                StrRef name;
+                int32_t numRequired;
+                uint32_t firstCourse, numCourses;// run of course refs
+        };
+
+        struct CourseRecord {
+                uint64_t key;// CourseKey value
+                StrRef name;
+                int32_t credits;
+                uint32_t reserved;
+        };
+
+        struct PrerequisiteRecord {
+                uint32_t course;// course ref
+                uint32_t firstPrerequisite, numPrerequisites;// run of course refs
+        };
+
+private:
+        MappedFile file;
+        const char *data;
+        size_t size;
+        const Header *header;
+        const MajorRecord *majors;
+        const CategoryRecord *categories;
+        const CourseRecord *courses;
+        const PrerequisiteRecord *prerequisites;
+        const uint32_t *refs;
+        const char *strings;
+        mutable std::vector<std::shared_ptr<const std::string> > names;// per course record, once read
+        mutable std::mutex namesLock;
+
+        static const char *magic() {
+                return "CGSNAP\0\0";
+        };
+
+        // true if a string reference lies inside the string section
+        bool valid(const StrRef &ref) const {
+                return ref.offset <= header->stringsSize && ref.length <= header->stringsSize - ref.offset;
+        };
+
+        // returns a referenced string (empty if the reference is out of bounds)
+        std::string str(const StrRef &ref) const {
+                if(!valid(ref)) {
+                        return "";
+                }
+                return std::string(strings + ref.offset, ref.length);
+        };
+
+        // compares a referenced string with s like std::string::compare
+        int compare(const StrRef &ref, const std::string &s) const {
+                if(!valid(ref)) {
+                        return s.empty() ? 0 : -1;
+                }
+                size_t n = std::min<size_t>(ref.length, s.length());
+                int cmp = std::memcmp(strings + ref.offset, s.data(), n);
+                if(cmp != 0) {
+                        return cmp;
+                }
+                return (ref.length < s.length()) ? -1 : (ref.length > s.length() ? 1 : 0);
+        };
+
+        // the name of a course record, read from the file the first time (namesLock is held)
+        const std::shared_ptr<const std::string> &nameOf(uint32_t ref) const {
+                std::shared_ptr<const std::string> &name = names[ref];
+                if(!name) {
+                        name = std::make_shared<const std::string>(str(courses[ref].name));
+                }
+                return name;
+        };
+
+        // namesLock is held
+        Course makeCourse(uint32_t ref) const {
+                if(ref >= header->numCourses) {
+                        return Course();
+                }
+                const CourseRecord &c = courses[ref];
+                return Course(c.credits, nameOf(ref), CourseKey(c.key));
+        };
+
+        // true if a section of count records of size bytes each lies inside the file
+        bool fits(uint64_t offset, uint64_t count, uint64_t bytes) const {
+                return offset <= size && count * bytes <= size - offset;
+        };
+
+        // true if a section can be read in place as records needing the given alignment
+        bool aligned(uint64_t offset, size_t alignment) const {
+                return offset % alignment == 0;
+        };
+
+        // the course record of a key (NULL if the course is not in the snapshot)
+        const CourseRecord *findCourse(CourseKey key) const {
+                const CourseRecord *end = courses + header->numCourses;
+                const CourseRecord *found = std::lower_bound(courses, end, key.value(),
+                                [](const CourseRecord &rec, uint64_t k) { return rec.key < k; });
+                return (found == end || found->key != key.value()) ? NULL : found;
+        };
+
+public:
+        CatalogSnapshot() {
+                this->data = NULL;
+                this->size = 0;
+                this->header = NULL;
+                this->majors = NULL;
+                this->categories = NULL;
+                this->courses = NULL;
+                this->prerequisites = NULL;
+                this->refs = NULL;
+                this->strings = NULL;
+        };
+
+        ~CatalogSnapshot() {
+                close();
+        };
+
+        CatalogSnapshot(const CatalogSnapshot &) = delete;
+        CatalogSnapshot &operator=(const CatalogSnapshot &) = delete;
+
+        /*
+         * Maps a snapshot file into memory.
+         * Returns false and describes the problem in error if the file is not a usable snapshot.
+         */
+        bool open(const std::string &path, std::string &error) {
+                close();
+                if(!file.open(path, error)) {
+                        return false;
+                }
+                if(file.getSize() < sizeof(Header)) {
+                        file.close();
+                        error = path + " is too small to be a catalog snapshot";
+                        return false;
+                }
+                data = file.getData();
+                size = file.getSize();
+                header = (const Header *)data;
+
+                if(std::memcmp(header->magic, magic(), sizeof(header->magic)) != 0) {
+                        error = path + " is not a catalog snapshot";
+                } else if(header->formatVersion != FORMAT_VERSION) {
+                        error = path + " has snapshot format version " + std::to_string(header->formatVersion)
+                                + " (expected " + std::to_string(FORMAT_VERSION) + ")";
+                } else if(!fits(header->majorsOffset, header->numMajors, sizeof(MajorRecord))
+                          || !fits(header->categoriesOffset, header->numCategories, sizeof(CategoryRecord))
+                          || !fits(header->coursesOffset, header->numCourses, sizeof(CourseRecord))
+                          || !fits(header->prerequisitesOffset, header->numPrerequisites, sizeof(PrerequisiteRecord))
+                          || !fits(header->refsOffset, header->numRefs, sizeof(uint32_t))
+                          || !fits(header->stringsOffset, header->stringsSize, 1)) {
+                        error = path + " is truncated";
+                } else if(!aligned(header->majorsOffset, alignof(MajorRecord))
+                          || !aligned(header->categoriesOffset, alignof(CategoryRecord))
+                          || !aligned(header->coursesOffset, alignof(CourseRecord))
+                          || !aligned(header->prerequisitesOffset, alignof(PrerequisiteRecord))
+                          || !aligned(header->refsOffset, alignof(uint32_t))) {
+                        error = path + " is damaged (a section is not aligned)";
+                } else {
+                        majors = (const MajorRecord *)(data + header->majorsOffset);
+                        categories = (const CategoryRecord *)(data + header->categoriesOffset);
+                        courses = (const CourseRecord *)(data + header->coursesOffset);
+                        prerequisites = (const PrerequisiteRecord *)(data + header->prerequisitesOffset);
+                        refs = (const uint32_t *)(data + header->refsOffset);
+                        strings = data + header->stringsOffset;
+                        names.assign(header->numCourses, std::shared_ptr<const std::string>());
+                        return true;
+                }
+                close();
+                return false;
+        };
+
+        void close() {
+                file.close();
+                data = NULL;
+                size = 0;
+                header = NULL;
+                names.clear();
+        };
+
+        bool isOpen() const {
+                return data != NULL;
+        };
+
+        // the catalog version of the database the snapshot was exported from
+        std::string getCatalogVersion() const {
+                return str(header->catalogVersion);
+        };
+
+        size_t getNumMajors() const {
+                return header->numMajors;
+        };
+
+        size_t getNumCourses() const {
+                return header->numCourses;
+        };
+
+        // the names of every major in the snapshot (sorted)
+        std::vector<std::string> getMajorNames() const {
+                std::vector<std::string> names;
+                for(uint32_t i = 0; i < header->numMajors; ++i) {
+                        names.push_back(str(majors[i].name));
+                }
+                return names;
+        };
+
+        /*
+         * Fills req with the requirements of a major.
+         * Returns false if the major is not in the snapshot.
+         */
+        bool getRequirements(const std::string &major, MajorRequirements &req) const {
+                // binary search the majors (sorted by name)
+                size_t lo = 0, hi = header->numMajors;
+                while(lo < hi) {
+                        size_t mid = lo + (hi - lo) / 2;
+                        int cmp = compare(majors[mid].name, major);
+                        if(cmp == 0) {
+                                lo = mid;
+                                break;
+                        }
+                        if(cmp < 0) {
+                                lo = mid + 1;
+                        } else {
+                                hi = mid;
+                        }
+                }
+                if(lo >= header->numMajors || compare(majors[lo].name, major) != 0) {
+                        return false;
+                }
+                const MajorRecord &m = majors[lo];
+                std::lock_guard<std::mutex> guard(namesLock);
+                req = MajorRequirements();
+                req.id = m.id;
+                req.major = major;
+                req.listing = str(m.listing);
+                for(uint32_t i = 0; i < m.numRequired && m.firstRequired + i < header->numRefs; ++i) {
+                        req.required.push_back(makeCourse(refs[m.firstRequired + i]));
+                }
+                for(uint32_t c = 0; c < m.numCategories && m.firstCategory + c < header->numCategories; ++c) {
+                        const CategoryRecord &rec = categories[m.firstCategory + c];
+                        OptionCategory category(str(rec.name), rec.numRequired);
+                        for(uint32_t i = 0; i < rec.numCourses && rec.firstCourse + i < header->numRefs; ++i) {
+                                category.courses.push_back(makeCourse(refs[rec.firstCourse + i]));
+                        }
+                        req.categories.push_back(category);
+                }
+                return true;
+        };
+
+        /*
+         * Fills in the name and credits of c from the snapshot.
+         * Returns false if the course is not in the snapshot.
+         */
+        bool getCourse(Course &c) const {
+                const CourseRecord *found = findCourse(c.getKey());
+                if(found == NULL) {
+                        return false;
+                }
+                std::lock_guard<std::mutex> guard(namesLock);
+                c.setName(nameOf(found - courses));
+                c.setCredits(found->credits);
+                return true;
+        };
+
+        // the prerequisites of a course, with their data (none if it has none or is not in the snapshot)
+        std::vector<Course> getPrerequisites(const Course &c) const {
+                std::vector<Course> list;
+                const CourseRecord *found = findCourse(c.getKey());
+                if(found == NULL) {
+                        return list;
+                }
+                uint32_t ref = found - courses;
+                const PrerequisiteRecord *end = prerequisites + header->numPrerequisites;
+                const PrerequisiteRecord *rec = std::lower_bound(prerequisites, end, ref,
+                                [](const PrerequisiteRecord &p, uint32_t r) { return p.course < r; });
+                if(rec == end || rec->course != ref) {
+                        return list;
+                }
+                std::lock_guard<std::mutex> guard(namesLock);
+                for(uint32_t i = 0; i < rec->numPrerequisites && rec->firstPrerequisite + i < header->numRefs; ++i) {
+                        list.push_back(makeCourse(refs[rec->firstPrerequisite + i]));
+                }
+                return list;
+        };
+
+        /*
+         * Writes the requirements of the given majors and the prerequisites of their courses
+         * (with the data of every course either references) to a snapshot file.
+         * Returns false and describes the problem in error if the file could not be written.
+         */
+        static bool write(const std::string &path, std::vector<MajorRequirements> &majorList,
+                          const std::map<CourseKey, std::vector<Course> > &prerequisiteList,
+                          const std::string &catalogVersion, std::string &error) {
+                std::string blob;
+                std::map<std::string, StrRef> stored;
+                auto addString = [&](const std::string &s) {
+                        auto found = stored.find(s);
+                        if(found != stored.end()) {
+                                return found->second;
+                        }
+                        StrRef ref;
+                        ref.offset = blob.size();
+                        ref.length = s.length();
+                        blob.append(s);
+                        stored[s] = ref;
+                        return ref;
+                };
+
+                // every distinct course, sorted by key, gets one course record
+                std::map<CourseKey, Course> courseData;
+                std::vector<MajorRequirements *> sorted;
+                for(auto it = majorList.begin(); it != majorList.end(); ++it) {
+                        sorted.push_back(&(*it));
+                        for(auto c = it->required.begin(); c != it->required.end(); ++c) {
+                                courseData[(*c).getKey()] = *c;
+                        }
+                        for(auto cat = it->categories.begin(); cat != it->categories.end(); ++cat) {
+                                for(auto c = cat->courses.begin(); c != cat->courses.end(); ++c) {
+                                        courseData[(*c).getKey()] = *c;
+                                }
+                        }
+                }
+                for(auto it = prerequisiteList.begin(); it != prerequisiteList.end(); ++it) {
+                        for(auto c = it->second.begin(); c != it->second.end(); ++c) {
+                                courseData.insert(std::make_pair((*c).getKey(), *c));
+                        }
+                }
+                std::sort(sorted.begin(), sorted.end(), [](MajorRequirements *a, MajorRequirements *b) {
+                        return a->major < b->major;
+                });
+                std::map<CourseKey, uint32_t> courseIndex;
+                std::vector<CourseRecord> courseRecords;
+                for(auto it = courseData.begin(); it != courseData.end(); ++it) {
+                        CourseRecord rec;
+                        std::memset(&rec, 0, sizeof(rec));
+                        rec.key = it->first.value();
+                        rec.name = addString(it->second.getName());
+                        rec.credits = it->second.getCredits();
+                        courseIndex[it->first] = courseRecords.size();
+                        courseRecords.push_back(rec);
+                }
+
+                std::vector<MajorRecord> majorRecords;
+                std::vector<CategoryRecord> categoryRecords;
+                std::vector<uint32_t> refList;
+                for(auto it = sorted.begin(); it != sorted.end(); ++it) {
+                        MajorRequirements &req = **it;
+                        MajorRecord rec;
+                        std::memset(&rec, 0, sizeof(rec));
+                        rec.name = addString(req.major);
+                        rec.listing = addString(req.listing);
+                        rec.id = req.id;
+                        rec.firstRequired = refList.size();
+                        rec.numRequired = req.required.size();
+                        for(auto c = req.required.begin(); c != req.required.end(); ++c) {
+                                refList.push_back(courseIndex[(*c).getKey()]);
+                        }
+                        rec.firstCategory = categoryRecords.size();
+                        rec.numCategories = req.categories.size();
+                        for(auto cat = req.categories.begin(); cat != req.categories.end(); ++cat) {
+                                CategoryRecord catRec;
+                                std::memset(&catRec, 0, sizeof(catRec));
+                                catRec.name = addString(cat->name);
+                                catRec.numRequired = cat->numRequired;
+                                catRec.firstCourse = refList.size();
+                                catRec.numCourses = cat->courses.size();
+                                for(auto c = cat->courses.begin(); c != cat->courses.end(); ++c) {
+                                        refList.push_back(courseIndex[(*c).getKey()]);
+                                }
+                                categoryRecords.push_back(catRec);
+                        }
+                        majorRecords.push_back(rec);
+                }
+                // in key order, which is also course ref order
+                std::vector<PrerequisiteRecord> prerequisiteRecords;
+                for(auto it = prerequisiteList.begin(); it != prerequisiteList.end(); ++it) {
+                        auto course = courseIndex.find(it->first);
+                        if(it->second.empty() || course == courseIndex.end()) {
+                                continue;
+                        }
+                        PrerequisiteRecord rec;
+                        std::memset(&rec, 0, sizeof(rec));
+                        rec.course = course->second;
+                        rec.firstPrerequisite = refList.size();
+                        rec.numPrerequisites = it->second.size();
+                        for(auto c = it->second.begin(); c != it->second.end(); ++c) {
+                                refList.push_back(courseIndex[(*c).getKey()]);
+                        }
+                        prerequisiteRecords.push_back(rec);
+                }
+
+                Header h;
+                std::memset(&h, 0, sizeof(h));
+                std::memcpy(h.magic, magic(), sizeof(h.magic));
+                h.formatVersion = FORMAT_VERSION;
+                h.numMajors = majorRecords.size();
+                h.numCategories = categoryRecords.size();
+                h.numCourses = courseRecords.size();
+                h.numPrerequisites = prerequisiteRecords.size();
+                h.numRefs = refList.size();
+                h.catalogVersion = addString(catalogVersion);
+                h.stringsSize = blob.size();
+                auto align = [](uint64_t offset) {
+                        return (offset + 7) & ~(uint64_t)7;
+                };
+                h.majorsOffset = align(sizeof(Header));
+                h.categoriesOffset = align(h.majorsOffset + majorRecords.size() * sizeof(MajorRecord));
+                h.coursesOffset = align(h.categoriesOffset + categoryRecords.size() * sizeof(CategoryRecord));
+                h.prerequisitesOffset = align(h.coursesOffset + courseRecords.size() * sizeof(CourseRecord));
+                h.refsOffset = align(h.prerequisitesOffset + prerequisiteRecords.size() * sizeof(PrerequisiteRecord));
+                h.stringsOffset = align(h.refsOffset + refList.size() * sizeof(uint32_t));
+
+                std::string file(h.stringsOffset + blob.size(), '\0');
+                std::memcpy(&file[0], &h, sizeof(h));
+                if(!majorRecords.empty()) {
+                        std::memcpy(&file[h.majorsOffset], majorRecords.data(), majorRecords.size() * sizeof(MajorRecord));
+                }
+                if(!categoryRecords.empty()) {
+                        std::memcpy(&file[h.categoriesOffset], categoryRecords.data(),
+                                    categoryRecords.size() * sizeof(CategoryRecord));
+                }
+                if(!courseRecords.empty()) {
+                        std::memcpy(&file[h.coursesOffset], courseRecords.data(), courseRecords.size() * sizeof(CourseRecord));
+                }
+                if(!prerequisiteRecords.empty()) {
+                        std::memcpy(&file[h.prerequisitesOffset], prerequisiteRecords.data(),
+                                    prerequisiteRecords.size() * sizeof(PrerequisiteRecord));
+                }
+                if(!refList.empty()) {
+                        std::memcpy(&file[h.refsOffset], refList.data(), refList.size() * sizeof(uint32_t));
+                }
+                std::memcpy(&file[h.stringsOffset], blob.data(), blob.size());
+
+                std::ofstream outFile(path, std::ios::binary | std::ios::trunc);
+                outFile.write(file.data(), file.size());
+                if(!outFile) {
+                        error = "could not write " + path;
+                        return false;
+                }
+                return true;
+        };
+};
+
+#endif
@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      CatalogSource.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    The interface audits use to read the course catalog, so
+//                 they do not depend on where it is kept. Implemented by the
+//                 database (MySqlCatalogSource), a fixture file held in
+//                 memory (InMemoryCatalogSource) and a catalog snapshot
+//                 (SnapshotCatalogSource).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CatalogSource_hpp
+#define CatalogSource_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include "Course.hpp"
+#include "MajorRequirements.hpp"
+
+/* One method per stored procedure of the course_guide_system database. Courses returned
+ * by the list methods only hold their ids; getCourseData fills in the rest.
+ * loadRequirements puts the pieces together into the requirements of a major. A source
+ * that can do that faster than one call per piece (a snapshot, or the database with
+ * pipelined calls) overrides it.
+ * Implementations must be safe to share between threads. Problems reaching the catalog
+ * are thrown (sql::SQLException, std::runtime_error).
+ */
+class CatalogSource {
+
+protected:
+        bool lazyElectives;
+
+        // true if the data of a category's courses is left for later (see setLazyElectives)
+        bool isPooled(const OptionCategory &category) const {
+                return lazyElectives && category.name == "Electives";
+        };
+
+public:
+        CatalogSource() {
+                this->lazyElectives = false;
+        };
+
+        virtual ~CatalogSource() {
+        };
+
+        /*
+         * With lazy set, loadRequirements leaves the course data of an Electives category
+         * unread and marks the category as pooled: its courses only hold their ids, which is
+         * all an audit needs. The data of the few courses shown is read later (see
+         * ChoicePager). A source whose course data costs nothing to read may ignore this.
+         */
+        void setLazyElectives(bool lazy) {
+                this->lazyElectives = lazy;
+        };
+
+        // get_major_id - false if the major does not exist
+        virtual bool getMajorId(const std::string &major, int &id) = 0;
+
+        // get_abs_req_courses - the courses the major absolutely requires
+        virtual std::vector<Course> getRequiredCourses(int majorId) = 0;
+
+        // getMajorOptions - the option categories of the major and how many courses each needs
+        virtual std::map<std::string, int> getMajorOptions(int majorId) = 0;
+
+        // getOptionalElectives - the courses to choose from in an option category
+        virtual std::vector<Course> getOptionalElectives(const std::string &category, int majorId) = 0;
+
+        // getListing - the listing of the major ("CS")
+        virtual std::string getListing(int majorId) = 0;
+
+        // getElectives - the courses that count as Electives for a listing
+        virtual std::vector<Course> getElectives(const std::string &listing) = 0;
+
+        // getCourseData - fills in the name and credits of every course in the list
+        virtual void getCourseData(std::vector<Course> &courses) = 0;
+
+        // getCatalogVersion - changes whenever the catalog is edited (empty if not known)
+        virtual std::string getCatalogVersion() = 0;
+
+        // getPrerequisites - the courses that must be passed before taking a course (all of
+        // them). Sources that do not record prerequisites keep this default of none.
+        virtual std::vector<Course> getPrerequisites(const Course &/*course*/) {
+                return std::vector<Course>();
+        };
+
+        // getPrerequisiteLists - getPrerequisites of every course in the list, in the same
+        // order. Sources that can look up many courses at once override it.
+        virtual std::vector<std::vector<Course> > getPrerequisiteLists(const std::vector<Course> &courses) {
+                std::vector<std::vector<Course> > lists;
+                for(auto it = courses.begin(); it != courses.end(); ++it) {
+                        lists.push_back(getPrerequisites(*it));
+                }
+                return lists;
+        };
+
+        // providesPrerequisites - false if getPrerequisites never finds any, so plans and
+        // eligible courses would ignore them
+        virtual bool providesPrerequisites() {
+                return false;
+        };
+
+        /*
+         * Fills req with the requirements of a major, with the data of every course in them.
+         * Returns false if the major does not exist.
+         */
+        virtual bool loadRequirements(const std::string &major, MajorRequirements &req) {
+                req = MajorRequirements();
+                if(!getMajorId(major, req.id)) {
+                        return false;
+                }
+                req.major = major;
+                req.required = getRequiredCourses(req.id);
+                req.categories = orderCategories(getMajorOptions(req.id));
+                for(auto it = req.categories.begin(); it != req.categories.end(); ++it) {
+                        if(it->name == "Electives") {
+                                // any class above 400 counts as an elective
+                                req.listing = getListing(req.id);
+                                it->courses = getElectives(req.listing);
+                        } else {
+                                it->courses = getOptionalElectives(it->name, req.id);
+                        }
+                }
+                // one getCourseData call for every course so the lookups can be shared
+                std::vector<Course> all(req.required);
+                for(auto it = req.categories.begin(); it != req.categories.end(); ++it) {
+                        it->pooled = isPooled(*it);
+                        if(!it->pooled) {
+                                all.insert(all.end(), it->courses.begin(), it->courses.end());
+                        }
+                }
+                getCourseData(all);
+                auto from = all.begin();
+                req.required.assign(from, from + req.required.size());
+                from += req.required.size();
+                for(auto it = req.categories.begin(); it != req.categories.end(); ++it) {
+                        if(!it->pooled) {
+                                it->courses.assign(from, from + it->courses.size());
+                                from += it->courses.size();
+                        }
+                }
+                return true;
+        };
+
+        // prints whatever the source counts (connections, statements) - nothing by default
+        virtual void printStats(std::ostream &/*out*/) {
+        };
+
+        /*
+         * Turns the result of getMajorOptions into categories in audit order.
+         * An Electives category goes last so courses are not used to fulfill electives
+         * before the other requirements.
+         */
+        static std::vector<OptionCategory> orderCategories(const std::map<std::string, int> &options) {
+                std::vector<OptionCategory> categories;
+                auto electives = options.find("Electives");
+                for(auto it = options.begin(); it != options.end(); ++it) {
+                        if(it != electives) {
+                                categories.push_back(OptionCategory(it->first, it->second));
+                        }
+                }
+                if(electives != options.end()) {
+                        categories.push_back(OptionCategory(electives->first, electives->second));
+                }
+                return categories;
+        };
+};
+
+#endif
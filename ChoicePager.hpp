@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      ChoicePager.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Cuts the Electives choices of an audit down to the page
+//                 that is shown and reads the course data of only those
+//                 courses, so a department with hundreds of electives does
+//                 not have all of them looked up and printed.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ChoicePager_hpp
+#define ChoicePager_hpp
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Course.hpp"
+#include "MajorRequirements.hpp"
+#include "AuditResult.hpp"
+#include "CatalogSource.hpp"
+#include "Metrics.hpp"
+
+// the order Electives choices are shown in
+enum ChoiceOrder {
+        CHOICES_LISTED,// as the catalog lists them
+        CHOICES_NUMBER,// by course id
+        CHOICES_CREDITS// fewest credits first (needs the data of every choice)
+};
+
+/* Shows limit choices of an Electives category at a time: page 0 holds the first limit
+ * choices in the chosen order, page 1 the next limit and so on. The audit itself has
+ * already run against the whole pool by course id; only the page is kept in the result
+ * (with the number of choices left off) and, if the pool was loaded lazily (see
+ * CatalogSource::setLazyElectives), only the page gets its course data read.
+ * The credits of the rest of a lazily loaded pool are never read, so creditsOutstanding of
+ * a pooled category is reported as unknown (CategoryResult::CREDITS_UNKNOWN). The credits
+ * order needs the credits of every choice, so it does not allow lazy pools (see
+ * allowsLazyPools); a pooled category is shown in the listed order instead.
+ * A limit of 0 shows every choice. Holds no state, so it can be shared between threads.
+ */
+class ChoicePager {
+
+private:
+        size_t limit, page;
+        ChoiceOrder order;
+
+public:
+        ChoicePager(size_t limit = 0, ChoiceOrder order = CHOICES_LISTED, size_t page = 0) {
+                this->limit = limit;
+                this->order = order;
+                this->page = page;
+        };
+
+        // true if apply() changes anything
+        bool isPaging() const {
+                return limit > 0;
+        };
+
+        // true if the Electives pools may be loaded lazily - only the page shown needs its data
+        bool allowsLazyPools() const {
+                return isPaging() && order != CHOICES_CREDITS;
+        };
+
+        // parses "listed", "number" or "credits"
+        static bool parseOrder(const std::string &name, ChoiceOrder &order) {
+                if(name == "listed") {
+                        order = CHOICES_LISTED;
+                } else if(name == "number") {
+                        order = CHOICES_NUMBER;
+                } else if(name == "credits") {
+                        order = CHOICES_CREDITS;
+                } else {
+                        return false;
+                }
+                return true;
+        };
+
+        /*
+         * Cuts the Electives choices of an audit against req down to the page and reads the
+         * data of the courses on it from source if the category is pooled.
+         * Exceptions from the source are passed on.
+         */
+        void apply(AuditResult &result, const MajorRequirements &req, CatalogSource &source) const {
+                if(limit == 0) {
+                        return;
+                }
+                for(size_t c = 0; c < result.getCategories().size() && c < req.categories.size(); ++c) {
+                        const CategoryResult &shown = result.getCategories()[c];
+                        if(shown.name != "Electives" || shown.isComplete()) {
+                                continue;// no choices are shown for a complete category
+                        }
+                        CategoryResult &category = result.editCategories()[c];
+                        bool pooled = req.categories[c].pooled;
+                        std::vector<Course> &choices = category.choices;
+                        if(order == CHOICES_NUMBER) {
+                                std::stable_sort(choices.begin(), choices.end());
+                        } else if(order == CHOICES_CREDITS && !pooled) {
+                                std::stable_sort(choices.begin(), choices.end(), [](const Course &a, const Course &b) {
+                                        return a.getCredits() < b.getCredits();
+                                });
+                        }
+                        size_t first = std::min(choices.size(), page * limit);
+                        size_t last = std::min(choices.size(), first + limit);
+                        category.moreChoices = choices.size() - (last - first);
+                        choices.erase(choices.begin() + last, choices.end());
+                        choices.erase(choices.begin(), choices.begin() + first);
+                        if(pooled) {
+                                static Counter &resolved = Metrics::instance().counter(
+                                        "course_guide_choices_resolved_total", "Pooled choices whose data was read");
+                                source.getCourseData(choices);
+                                resolved.add(choices.size());
+                                // the page only holds some of the pool
+                                category.creditsOutstanding = CategoryResult::CREDITS_UNKNOWN;
+                        }
+                }
+        };
+};
+
+#endif
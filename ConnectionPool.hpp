@@ -0,0 +1,423 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      ConnectionPool.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Where the database lives (read from a config file and the
+//                 environment) and a pool of open connections to it that
+//                 audits borrow and give back, so each audit does not pay
+//                 for a new TCP connection and login.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ConnectionPool_hpp
+#define ConnectionPool_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CourseDatabase.hpp"
+
+// include mysql/c++ connector headers
+#include "mysql_driver.h"
+#include <cppconn/driver.h>
+
+/* How to reach the database. Settings come from a config file of "key = value" lines
+ * ('#' starts a comment) and can be overridden by environment variables named
+ * COURSE_GUIDE_DB_<KEY> (for example COURSE_GUIDE_DB_PASSWORD). Keys:
+ *   host              connector URL of the server (tcp://127.0.0.1:3306 or unix:///path/to/socket)
+ *   user, password    login (no defaults - both must be given, the password may be empty)
+ *   schema            database to use (course_guide_system)
+ *   pool_size         most connections open at once (0 - as many as there are workers)
+ *   connect_retries   extra attempts when a connection can not be made
+ *   retry_backoff_ms  wait before the first retry (doubled for each retry after it)
+ *   validate_after_s  a connection idle for longer than this is checked before it is lent
+ */
+struct DatabaseConfig {
+        std::string host, user, password, schema;
+        bool passwordSet;// false until a password is given (an empty one counts)
+        unsigned int poolSize;
+        int connectRetries;
+        int retryBackoffMs;
+        int validateAfterSec;
+
+        DatabaseConfig() {
+                this->host = "tcp://127.0.0.1:3306";
+                this->passwordSet = false;
+                this->schema = "course_guide_system";
+                this->poolSize = 0;
+                this->connectRetries = 3;
+                this->retryBackoffMs = 100;
+                this->validateAfterSec = 30;
+        };
+
+        /*
+         * Sets one setting by its key.
+         * Returns false and describes the problem in error if the key or value is not valid.
+         */
+        bool set(const std::string &key, const std::string &value, std::string &error) {
+                if(key == "host") {
+                        host = value;
+                } else if(key == "user") {
+                        user = value;
+                } else if(key == "password") {
+                        password = value;
+                        passwordSet = true;
+                } else if(key == "schema") {
+                        schema = value;
+                } else if(key == "pool_size" || key == "connect_retries" || key == "retry_backoff_ms"
+                          || key == "validate_after_s") {
+                        char *end = NULL;
+                        long n = std::strtol(value.c_str(), &end, 10);
+                        if(value.empty() || *end != '\0' || n < 0) {
+                                error = key + " must be a number, not \"" + value + "\"";
+                                return false;
+                        }
+                        if(key == "pool_size") {
+                                poolSize = n;
+                        } else if(key == "connect_retries") {
+                                connectRetries = n;
+                        } else if(key == "retry_backoff_ms") {
+                                retryBackoffMs = n;
+                        } else {
+                                validateAfterSec = n;
+                        }
+                } else {
+                        error = "unknown database setting " + key;
+                        return false;
+                }
+                return true;
+        };
+
+        // reads the settings in a config file
+        bool readFile(const std::string &path, std::string &error) {
+                std::ifstream file(path);
+                if(!file) {
+                        error = "could not open " + path;
+                        return false;
+                }
+                std::string line;
+                int lineNum = 0;
+                while(getline(file, line)) {
+                        ++lineNum;
+                        std::string::size_type hash = line.find('#');
+                        if(hash != std::string::npos) {
+                                line.erase(hash);
+                        }
+                        std::string::size_type equals = line.find('=');
+                        if(equals == std::string::npos) {
+                                if(trim(line).empty()) {
+                                        continue;
+                                }
+                                error = path + ":" + std::to_string(lineNum) + ": expected key = value";
+                                return false;
+                        }
+                        if(!set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)), error)) {
+                                error = path + ":" + std::to_string(lineNum) + ": " + error;
+                                return false;
+                        }
+                }
+                return true;
+        };
+
+        // applies the COURSE_GUIDE_DB_<KEY> environment variables that are set
+        bool readEnvironment(std::string &error) {
+                static const char *keys[] = { "host", "user", "password", "schema", "pool_size",
+                                              "connect_retries", "retry_backoff_ms", "validate_after_s" };
+                for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+                        std::string name("COURSE_GUIDE_DB_");
+                        for(const char *c = keys[i]; *c != '\0'; ++c) {
+                                name.push_back(std::toupper((unsigned char)*c));
+                        }
+                        const char *value = std::getenv(name.c_str());
+                        if(value != NULL && !set(keys[i], value, error)) {
+                                error = name + ": " + error;
+                                return false;
+                        }
+                }
+                return true;
+        };
+
+        /*
+         * Loads the settings: the defaults, then the config file (path, or the file named by
+         * COURSE_GUIDE_DB_CONFIG if path is empty), then the environment.
+         * Returns false and describes the problem in error if a setting is not valid or the
+         * login was not given.
+         */
+        static bool load(std::string path, DatabaseConfig &config, std::string &error) {
+                config = DatabaseConfig();
+                if(path.empty() && std::getenv("COURSE_GUIDE_DB_CONFIG") != NULL) {
+                        path = std::getenv("COURSE_GUIDE_DB_CONFIG");
+                }
+                if(!path.empty() && !config.readFile(path, error)) {
+                        return false;
+                }
+                if(!config.readEnvironment(error)) {
+                        return false;
+                }
+                if(config.user.empty() || !config.passwordSet) {
+                        error = "no database login - set user and password in the config file (--db-config or "
+                                "COURSE_GUIDE_DB_CONFIG) or COURSE_GUIDE_DB_USER and COURSE_GUIDE_DB_PASSWORD";
+                        return false;
+                }
+                return true;
+        };
+
+private:
+        static std::string trim(const std::string &s) {
+                std::string::size_type begin = s.find_first_not_of(" \t\r");
+                if(begin == std::string::npos) {
+                        return "";
+                }
+                return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+        };
+};
+
+/* Lends out open CourseDatabases (connections plus their prepared statements). A borrowed
+ * connection comes back to the pool when its Lease goes away, so the statements it has
+ * prepared are reused by whoever borrows it next. At most poolSize connections are open;
+ * when all of them are lent out borrow() waits for one to come back.
+ * Safe to share between threads.
+ */
+class ConnectionPool {
+
+public:
+        /* A borrowed connection. Returns the connection to the pool when destroyed.
+         * Call discard() instead if the connection may be broken (for example after an
+         * exception in the middle of a batch) so it is closed rather than lent again.
+         */
+        class Lease {
+
+        private:
+                ConnectionPool *pool;
+                std::unique_ptr<CourseDatabase> db;
+
+        public:
+                Lease() {
+                        this->pool = NULL;
+                };
+
+                Lease(ConnectionPool *pool, std::unique_ptr<CourseDatabase> db) : db(std::move(db)) {
+                        this->pool = pool;
+                };
+
+                Lease(Lease &&other) : db(std::move(other.db)) {
+                        this->pool = other.pool;
+                        other.pool = NULL;
+                };
+
+                Lease &operator=(Lease &&other) {
+                        if(this != &other) {
+                                release();
+                                pool = other.pool;
+                                db = std::move(other.db);
+                                other.pool = NULL;
+                        }
+                        return *this;
+                };
+
+                ~Lease() {
+                        release();
+                };
+
+                explicit operator bool() const {
+                        return db != NULL;
+                };
+
+                CourseDatabase &operator*() const {
+                        return *db;
+                };
+
+                CourseDatabase *operator->() const {
+                        return db.get();
+                };
+
+                // gives the connection back to the pool
+                void release() {
+                        if(db) {
+                                pool->giveBack(std::move(db), true);
+                        }
+                };
+
+                // closes the connection instead of giving it back
+                void discard() {
+                        if(db) {
+                                pool->giveBack(std::move(db), false);
+                        }
+                };
+        };
+
+private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Idle {
+                std::unique_ptr<CourseDatabase> db;
+                Clock::time_point since;// when it was given back
+        };
+
+        static constexpr int MAX_BACKOFF_MS = 5000;
+
+        DatabaseConfig config;
+        sql::Driver *driver;
+        std::vector<Idle> idle;
+        unsigned int open;// connections that exist (idle or lent out)
+        std::map<std::string, StatementStats> closedStats;// statement stats of closed connections
+        unsigned long connects, failedConnects, dropped, borrows, waits;
+        std::mutex lock;
+        std::condition_variable available;
+
+        // errors that retrying will not fix (bad login, unknown database)
+        static bool isPermanent(const sql::SQLException &e) {
+                return e.getErrorCode() == 1044 || e.getErrorCode() == 1045 || e.getErrorCode() == 1049;
+        };
+
+        /*
+         * Opens a new connection, retrying with a growing wait if the server can not be reached.
+         * Returns an empty pointer and describes the last failure in error if every attempt fails.
+         */
+        std::unique_ptr<CourseDatabase> connect(std::string &error) {
+                int backoff = config.retryBackoffMs;
+                for(int attempt = 0; ; ++attempt) {
+                        try {
+                                // multi statements are needed so course data can be fetched in batches
+                                sql::ConnectOptionsMap options;
+                                options["hostName"] = sql::SQLString(config.host);
+                                options["userName"] = sql::SQLString(config.user);
+                                options["password"] = sql::SQLString(config.password);
+                                options["CLIENT_MULTI_STATEMENTS"] = true;
+                                std::unique_ptr<sql::Connection> con(driver->connect(options));
+                                con->setSchema(config.schema);
+                                return std::unique_ptr<CourseDatabase>(new CourseDatabase(std::move(con)));
+                        }
+                        catch(sql::SQLException &e) {
+                                error = "could not connect to " + config.host + " as " + config.user + ": "
+                                        + e.what() + " (MySQL error code: " + std::to_string(e.getErrorCode())
+                                        + ", SQLState: " + std::string(e.getSQLState()) + " )";
+                                if(attempt >= config.connectRetries || isPermanent(e)) {
+                                        return std::unique_ptr<CourseDatabase>();
+                                }
+                        }
+                        std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+                        backoff = std::min(backoff * 2, MAX_BACKOFF_MS);
+                }
+        };
+
+        // takes back a lent connection (closing it if it is not healthy) - called by Lease
+        void giveBack(std::unique_ptr<CourseDatabase> db, bool healthy) {
+                std::lock_guard<std::mutex> guard(lock);
+                if(healthy) {
+                        Idle entry;
+                        entry.db = std::move(db);
+                        entry.since = Clock::now();
+                        idle.push_back(std::move(entry));
+                } else {
+                        close(std::move(db));
+                }
+                available.notify_one();
+        };
+
+        // closes a connection, keeping its statement stats (lock must be held)
+        void close(std::unique_ptr<CourseDatabase> db) {
+                CourseDatabase::mergeStats(closedStats, db->getStats());
+                db.reset();
+                --open;
+                ++dropped;
+        };
+
+public:
+        explicit ConnectionPool(const DatabaseConfig &config) {
+                this->config = config;
+                if(this->config.poolSize == 0) {
+                        this->config.poolSize = 1;
+                }
+                this->driver = get_driver_instance();
+                this->open = 0;
+                this->connects = 0;
+                this->failedConnects = 0;
+                this->dropped = 0;
+                this->borrows = 0;
+                this->waits = 0;
+        };
+
+        ConnectionPool(const ConnectionPool &) = delete;
+        ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+        /*
+         * Lends out a connection: an idle one if there is one (checked first if it has been
+         * idle a while), a new one if the pool is not full, otherwise the next one given back.
+         * Returns an empty Lease and describes the problem in error if no connection can be made.
+         */
+        Lease borrow(std::string &error) {
+                std::unique_lock<std::mutex> guard(lock);
+                ++borrows;
+                while(true) {
+                        if(!idle.empty()) {
+                                Idle entry = std::move(idle.back());
+                                idle.pop_back();
+                                if(Clock::now() - entry.since < std::chrono::seconds(config.validateAfterSec)) {
+                                        return Lease(this, std::move(entry.db));
+                                }
+                                // ping the server without holding up the other threads
+                                guard.unlock();
+                                bool valid = entry.db->isValid();
+                                guard.lock();
+                                if(valid) {
+                                        return Lease(this, std::move(entry.db));
+                                }
+                                close(std::move(entry.db));// reconnect below
+                                continue;
+                        }
+                        if(open < config.poolSize) {
+                                ++open;// reserve the slot while connecting
+                                guard.unlock();
+                                std::unique_ptr<CourseDatabase> db = connect(error);
+                                guard.lock();
+                                if(!db) {
+                                        --open;
+                                        ++failedConnects;
+                                        available.notify_one();// let a waiting thread try
+                                        return Lease();
+                                }
+                                ++connects;
+                                return Lease(this, std::move(db));
+                        }
+                        ++waits;
+                        available.wait(guard);
+                }
+        };
+
+        const DatabaseConfig &getConfig() const {
+                return config;
+        };
+
+        // statement statistics of every connection the pool has had (lent out connections excluded)
+        std::map<std::string, StatementStats> getStatementStats() {
+                std::lock_guard<std::mutex> guard(lock);
+                std::map<std::string, StatementStats> total(closedStats);
+                for(auto it = idle.begin(); it != idle.end(); ++it) {
+                        CourseDatabase::mergeStats(total, it->db->getStats());
+                }
+                return total;
+        };
+
+        void printStats(std::ostream &out) {
+                {
+                        std::lock_guard<std::mutex> guard(lock);
+                        out << "Connection pool: " << connects << " connections opened, " << failedConnects
+                            << " failed, " << dropped << " closed, " << borrows << " borrows, "
+                            << waits << " waits" << std::endl;
+                }
+                CourseDatabase::printStats(out, getStatementStats());
+        };
+};
+
+#endif
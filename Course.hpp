@@ -5,8 +5,9 @@
 // CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
 //
 // Description:    Represents a Course at uw madison and contains basic info
-//                 like name, listing, number, credits.
-//                 
+//                 like name, listing, number, credits. The listing and
+//                 number are held as a packed CourseKey and the name is
+//                 shared by every copy of the course.
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef classnode_hpp
@@ -14,62 +15,97 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <iostream>
+#include "CourseKey.hpp"
 
 class Course {
 
 private:
         int credits;
-        std::string name, courseNum;
+        std::shared_ptr<const std::string> name;// never changed once set (null for no name)
+        CourseKey key;// packed course id ("CS302")
 
 public:
         Course() {
                 this->credits = 0;
-                this->name = "";
-                this->courseNum = "";
         };
 
+	// courseNum is parsed once here - an invalid id gives an invalid key
 	Course(std::string courseNum) {
-		this->courseNum = courseNum;
+		this->key = CourseKey::parse(courseNum);
                 // filler
  		this->credits = 0;
-                this->name = "";
+	}
+
+	Course(CourseKey key) {
+		this->key = key;
+ 		this->credits = 0;
 	}
 
         Course(int credits, std::string name, std::string courseNum) {
                 this->credits = credits;
-                this->name = name;
-                this->courseNum = courseNum;
+                setName(std::move(name));
+                this->key = CourseKey::parse(courseNum);
+        };
+
+        Course(int credits, std::string name, CourseKey key) {
+                this->credits = credits;
+                setName(std::move(name));
+                this->key = key;
+        };
+
+        // shares a name another course (or a CatalogSnapshot) already holds - nothing is copied
+        Course(int credits, std::shared_ptr<const std::string> name, CourseKey key) {
+                this->credits = credits;
+                this->name = std::move(name);
+                this->key = key;
         };
 
         bool operator==(const Course &other) const {
-		if(courseNum.compare(other.courseNum) == 0) {
-			return true;
-		}
-		return false;
+		return key == other.key;
 	}
 
 	bool operator!=(const Course &other) const {
 		return !(*this==other);
 	} 
 
-	void printId() {
-		std::cout << courseNum << std::endl;
+	bool operator<(const Course &other) const {
+		return key < other.key;
+	}
+
+	void printId(std::ostream &out = std::cout) const {
+		out << key.toString() << std::endl;
 	}	
 
-        void printData() {
-		std::cout << name << " - " << courseNum << std::endl;
-  		std::cout << "   Credits = " << credits << std::endl;
+        void printData(std::ostream &out = std::cout) const {
+		out << getName() << " - " << key.toString() << std::endl;
+  		out << "   Credits = " << credits << std::endl;
   	}
-        int getCredits() {
+        int getCredits() const {
                 return credits;
         };
 
-        std::string getName() {
+        const std::string &getName() const {
+                static const std::string none;
+                return name ? *name : none;
+        };
+
+        std::string getCourseNum() const {
+                return key.toString();
+        }
+
+        // the name itself, for another course to share (see Course(int, shared_ptr, CourseKey))
+        const std::shared_ptr<const std::string> &getSharedName() const {
                 return name;
         };
 
-        std::string getCourseNum() {
-                return courseNum;
+        CourseKey getKey() const {
+                return key;
+        }
+
+        bool isValid() const {
+                return key.isValid();
         }
 
         void setCredits(int credits) {
@@ -77,13 +113,30 @@ public:
         };
 
 	void setName(std::string name) {
-                this->name = name;
+                this->name = name.empty() ? std::shared_ptr<const std::string>()
+                                          : std::make_shared<const std::string>(std::move(name));
+        };
+
+        void setName(std::shared_ptr<const std::string> name) {
+                this->name = std::move(name);
         };
 
         void setCourseNum(std::string courseNum) {
-                this->courseNum = courseNum;
+                this->key = CourseKey::parse(courseNum);
+        };
+
+        void setKey(CourseKey key) {
+                this->key = key;
         };
 };
+
+namespace std {
+        template<> struct hash<Course> {
+                size_t operator()(const Course &c) const {
+                        return hash<CourseKey>()(c.getKey());
+                };
+        };
+}
 #endif
 
 
@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      CourseCatalog.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    A process wide cache of course data (name and credits)
+//                 keyed by CourseKey. Lets populateCourseData skip the
+//                 database for courses that have already been looked up.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CourseCatalog_hpp
+#define CourseCatalog_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include "Course.hpp"
+
+/* Caches the name and credits of every course that has been fetched from the database.
+ * The cache remembers the catalog version its entries were loaded under. When the
+ * database reports a different version the whole cache is dropped and refilled lazily.
+ * Safe to share between threads.
+ */
+class CourseCatalog {
+
+private:
+        struct Entry {
+                std::shared_ptr<const std::string> name;// shared with the courses filled in from it
+                int credits;
+        };
+
+        std::unordered_map<CourseKey, Entry> courses;
+        std::string version;// catalog version the cached entries belong to
+        unsigned long hits, misses, invalidations;
+        mutable std::mutex lock;
+
+        CourseCatalog() {
+                this->hits = 0;
+                this->misses = 0;
+                this->invalidations = 0;
+        };
+
+public:
+        CourseCatalog(const CourseCatalog &) = delete;
+        CourseCatalog &operator=(const CourseCatalog &) = delete;
+
+        // the single catalog shared by the whole process
+        static CourseCatalog &instance() {
+                static CourseCatalog catalog;
+                return catalog;
+        };
+
+        /*
+         * Fills in the name and credits of c if its course id is cached.
+         * Returns false (and counts a miss) if the course must come from the database.
+         */
+        bool lookup(Course &c) {
+                std::lock_guard<std::mutex> guard(lock);
+                auto it = courses.find(c.getKey());
+                if(it == courses.end()) {
+                        ++misses;
+                        return false;
+                }
+                ++hits;
+                c.setName(it->second.name);
+                c.setCredits(it->second.credits);
+                return true;
+        };
+
+        // adds (or replaces) the cached data of a course
+        void insert(Course c) {
+                std::lock_guard<std::mutex> guard(lock);
+                Entry &e = courses[c.getKey()];
+                e.name = c.getSharedName();
+                e.credits = c.getCredits();
+        };
+
+        // bulk warms the cache with courses that already hold their data
+        void warm(std::vector<Course> &loaded) {
+                std::lock_guard<std::mutex> guard(lock);
+                for(auto it = loaded.begin(); it != loaded.end(); ++it) {
+                        Entry &e = courses[(*it).getKey()];
+                        e.name = (*it).getSharedName();
+                        e.credits = (*it).getCredits();
+                }
+        };
+
+        // drops every cached course
+        void invalidate() {
+                std::lock_guard<std::mutex> guard(lock);
+                courses.clear();
+                ++invalidations;
+        };
+
+        /*
+         * Compares the version reported by the database with the version of the cache.
+         * If they differ the cache is stale: it is cleared and adopts the new version.
+         * Returns true if the cache was invalidated.
+         */
+        bool checkVersion(const std::string &current) {
+                std::lock_guard<std::mutex> guard(lock);
+                if(current == version) {
+                        return false;
+                }
+                version = current;
+                if(courses.empty()) {
+                        return false;// nothing cached yet - no need to count an invalidation
+                }
+                courses.clear();
+                ++invalidations;
+                return true;
+        };
+
+        std::string getVersion() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return version;
+        };
+
+        size_t size() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return courses.size();
+        };
+
+        unsigned long getHits() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return hits;
+        };
+
+        unsigned long getMisses() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return misses;
+        };
+
+        void printStats(std::ostream &out) const {
+                std::lock_guard<std::mutex> guard(lock);
+                out << "Course catalog: " << courses.size() << " courses cached, "
+                    << hits << " hits, " << misses << " misses, "
+                    << invalidations << " invalidations" << std::endl;
+        };
+};
+
+#endif
@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      CourseDatabase.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    A connection to the course_guide_system database that
+//                 prepares each stored procedure call once and reuses the
+//                 statement for the life of the connection. Counts the
+//                 calls made with every statement, the rows they fetched
+//                 and how long they took.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CourseDatabase_hpp
+#define CourseDatabase_hpp
+
+#include <string>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "Metrics.hpp"
+
+// include mysql/c++ connector headers
+#include "mysql_connection.h"
+#include <cppconn/exception.h>
+#include <cppconn/resultset.h>
+#include <cppconn/statement.h>
+#include <cppconn/prepared_statement.h>
+
+// the number of calls made with one statement, the rows they fetched and the time they took
+struct StatementStats {
+        unsigned long calls;
+        unsigned long rows;
+        double totalMs;
+        double maxMs;
+
+        StatementStats() {
+                this->calls = 0;
+                this->rows = 0;
+                this->totalMs = 0;
+                this->maxMs = 0;
+        };
+
+        void record(double ms, unsigned long rows) {
+                ++calls;
+                this->rows += rows;
+                totalMs += ms;
+                maxMs = std::max(maxMs, ms);
+        };
+
+        void add(const StatementStats &other) {
+                calls += other.calls;
+                rows += other.rows;
+                totalMs += other.totalMs;
+                maxMs = std::max(maxMs, other.maxMs);
+        };
+};
+
+/* Wraps one database connection. Every statement run through call() is prepared the first
+ * time it is used and the handle is kept, so later calls only send their parameters.
+ * Parameters are bound rather than pasted into the SQL, so names holding quotes are safe.
+ * Multi statement batches (see callBatch) are the one place SQL is still built as text;
+ * the values in them go through quote().
+ * Not safe to share between threads - give every thread its own CourseDatabase.
+ */
+class CourseDatabase {
+
+private:
+        // the connection is declared first so it outlives the statements made from it
+        std::unique_ptr<sql::Connection> con;
+        std::map<std::string, std::unique_ptr<sql::PreparedStatement> > prepared;
+        std::unique_ptr<sql::Statement> text;// runs the multi statement batches
+        std::map<std::string, StatementStats> stats;
+
+        typedef std::chrono::steady_clock Clock;
+
+        static double elapsedMs(Clock::time_point start) {
+                return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        };
+
+        // counts a call in the statistics of the connection and in the process wide metrics
+        void record(const std::string &sql, double ms, unsigned long rows) {
+                stats[sql].record(ms, rows);
+                if(Metrics::enabled()) {
+                        Metrics &metrics = Metrics::instance();
+                        std::string label = Metrics::label("statement", sql);
+                        metrics.histogram("course_guide_db_call_seconds", "Latency of each database statement",
+                                          label).observe(ms / 1000);
+                        metrics.counter("course_guide_db_calls_total", "Calls made with each database statement",
+                                        label).add();
+                        metrics.counter("course_guide_db_rows_total", "Rows fetched by each database statement",
+                                        label).add(rows);
+                }
+        };
+
+        // the prepared handle of a statement (prepared on first use)
+        sql::PreparedStatement &prepare(const std::string &sql) {
+                auto it = prepared.find(sql);
+                if(it == prepared.end()) {
+                        // only keep the handle once the server has accepted the statement
+                        std::unique_ptr<sql::PreparedStatement> stmt(con->prepareStatement(sql));
+                        it = prepared.insert(std::make_pair(sql, std::move(stmt))).first;
+                }
+                return *it->second;
+        };
+
+public:
+        explicit CourseDatabase(std::unique_ptr<sql::Connection> con) : con(std::move(con)) {
+        };
+
+        CourseDatabase(const CourseDatabase &) = delete;
+        CourseDatabase &operator=(const CourseDatabase &) = delete;
+
+        sql::Connection &getConnection() {
+                return *con;
+        };
+
+        // true if the server still answers on this connection
+        bool isValid() {
+                try {
+                        return con->isValid();
+                }
+                catch(sql::SQLException &e) {
+                        return false;
+                }
+        };
+
+        /*
+         * Runs a statement with ? placeholders. bind(sql::PreparedStatement &) sets the
+         * parameters and onRow(sql::ResultSet &) is called for every row of every result
+         * set the statement produces (a CALL may produce several).
+         * Throws sql::SQLException if the statement fails.
+         */
+        template<typename Bind, typename Row>
+        void call(const std::string &sql, Bind bind, Row onRow) {
+                Clock::time_point start = Clock::now();
+                sql::PreparedStatement &stmt = prepare(sql);
+                stmt.clearParameters();
+                bind(stmt);
+                stmt.execute();
+                // read every result so the connection is ready for the next statement
+                std::unique_ptr<sql::ResultSet> res;
+                unsigned long rows = 0;
+                do {
+                        res.reset(stmt.getResultSet());
+                        while(res && res->next()) {
+                                onRow(*res);
+                                ++rows;
+                        }
+                } while(stmt.getMoreResults());
+                record(sql, elapsedMs(start), rows);
+        };
+
+        // runs a statement without parameters
+        template<typename Row>
+        void call(const std::string &sql, Row onRow) {
+                call(sql, [](sql::PreparedStatement &) {}, onRow);
+        };
+
+        /*
+         * Sends count statements (built by the caller, separated by ';') in one round trip.
+         * onResult(size_t index, sql::ResultSet &) is called with the result set of each
+         * statement in order. The connection must allow multi statements. label names the
+         * batch in the statistics. Throws sql::SQLException if the batch fails.
+         */
+        template<typename Result>
+        void callBatch(const std::string &label, const std::string &sql, size_t count, Result onResult) {
+                Clock::time_point start = Clock::now();
+                if(!text) {
+                        text.reset(con->createStatement());
+                }
+                text->execute(sql);
+                // each CALL produces one result set (followed by a status result with no rows)
+                // so the result sets come back in the same order as the statements
+                std::unique_ptr<sql::ResultSet> res;
+                size_t current = 0;
+                unsigned long rows = 0;
+                do {
+                        res.reset(text->getResultSet());
+                        if(!res) {
+                                continue;// status result of the previous CALL
+                        }
+                        rows += res->rowsCount();
+                        onResult(current, *res);
+                        ++current;
+                } while(current < count && (text->getMoreResults() || res));
+                // read the status result of the last CALL too, so the connection is ready for the
+                // next statement (like call)
+                while(text->getMoreResults()) {
+                        res.reset(text->getResultSet());
+                }
+                record(label, elapsedMs(start), rows);
+        };
+
+        // a string literal holding s, for SQL that is built as text
+        static std::string quote(const std::string &s) {
+                std::string quoted("'");
+                for(auto it = s.begin(); it != s.end(); ++it) {
+                        if(*it == '\'' || *it == '\\') {
+                                quoted.push_back('\\');
+                        }
+                        quoted.push_back(*it);
+                }
+                quoted.push_back('\'');
+                return quoted;
+        };
+
+        // statistics of every statement run on this connection
+        const std::map<std::string, StatementStats> &getStats() const {
+                return stats;
+        };
+
+        // adds the statistics of one connection to a running total (used to combine threads)
+        static void mergeStats(std::map<std::string, StatementStats> &total,
+                               const std::map<std::string, StatementStats> &more) {
+                for(auto it = more.begin(); it != more.end(); ++it) {
+                        total[it->first].add(it->second);
+                }
+        };
+
+        static void printStats(std::ostream &out, const std::map<std::string, StatementStats> &stats) {
+                std::streamsize precision = out.precision();
+                out << "Statements:" << std::endl;
+                for(auto it = stats.begin(); it != stats.end(); ++it) {
+                        const StatementStats &s = it->second;
+                        out << "  " << it->first << ": " << s.calls << " calls, " << s.rows << " rows, "
+                            << std::fixed << std::setprecision(3)
+                            << s.totalMs << " ms total, " << (s.calls > 0 ? s.totalMs / s.calls : 0)
+                            << " ms avg, " << s.maxMs << " ms max" << std::endl;
+                }
+                out << std::defaultfloat << std::setprecision(precision);
+        };
+
+        void printStats(std::ostream &out) const {
+                printStats(out, stats);
+        };
+};
+
+#endif
@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      CourseDemand.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Counts, over a whole cohort of audited students, how many
+//                 still need each course: as a required course, as a choice
+//                 for an option category or as an elective, broken down by
+//                 the students' year. Used by --demand mode for capacity
+//                 planning.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CourseDemand_hpp
+#define CourseDemand_hpp
+
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <unordered_map>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "AuditResult.hpp"
+#include "ReportWriter.hpp"
+
+// why a student still needs a course
+enum DemandKind {
+        DEMAND_REQUIRED,// a required course not yet taken
+        DEMAND_OPTION,// a choice of an option category not yet filled
+        DEMAND_ELECTIVE,// a choice of an Electives category not yet filled
+        NUM_DEMAND_KINDS
+};
+
+/* The demand for every course, kept column by column: a column of course keys (and
+ * names) plus one column of student counts per kind of need and year, all indexed by the
+ * course's row. Counting a student touches a few counts in columns that sit together in
+ * memory, and merging two tables is a pass down each column.
+ * A student counts at most once per course and kind, even if the course is a choice of
+ * several of their categories (or majors).
+ * Each thread fills its own table (nothing is locked) and the tables are merged once all
+ * students are counted.
+ */
+class DemandTable {
+
+public:
+        static constexpr int MAX_YEAR = 5;// later years are counted with it
+        static constexpr int NUM_YEARS = MAX_YEAR + 1;// year 0 holds students with no valid year
+
+private:
+        std::vector<CourseKey> keys;
+        std::vector<std::string> names;
+        std::vector<uint32_t> counts[NUM_DEMAND_KINDS][NUM_YEARS];
+        std::vector<uint32_t> seen[NUM_DEMAND_KINDS];// serial of the last student counted
+        std::unordered_map<CourseKey, uint32_t> rows;
+        uint64_t students[NUM_YEARS];
+        uint64_t unknownMajor;
+        uint32_t serial;
+
+        uint32_t row(const Course &c) {
+                auto found = rows.find(c.getKey());
+                if(found != rows.end()) {
+                        if(names[found->second].empty()) {
+                                names[found->second] = c.getName();
+                        }
+                        return found->second;
+                }
+                uint32_t r = (uint32_t)keys.size();
+                rows.insert(std::make_pair(c.getKey(), r));
+                keys.push_back(c.getKey());
+                names.push_back(c.getName());
+                for(int kind = 0; kind < NUM_DEMAND_KINDS; ++kind) {
+                        for(int year = 0; year < NUM_YEARS; ++year) {
+                                counts[kind][year].push_back(0);
+                        }
+                        seen[kind].push_back(0);
+                }
+                return r;
+        };
+
+        void count(const Course &c, DemandKind kind, int year) {
+                uint32_t r = row(c);
+                if(seen[kind][r] != serial) {
+                        seen[kind][r] = serial;
+                        ++counts[kind][year][r];
+                }
+        };
+
+        // counts the courses still needed for one major of the student counted last
+        void countNeeds(const AuditResult &r, int year) {
+                for(auto it = r.requiredRemaining.begin(); it != r.requiredRemaining.end(); ++it) {
+                        count(*it, DEMAND_REQUIRED, year);
+                }
+                for(auto c = r.getCategories().begin(); c != r.getCategories().end(); ++c) {
+                        if(c->isComplete()) {
+                                continue;
+                        }
+                        DemandKind kind = (c->name == "Electives") ? DEMAND_ELECTIVE : DEMAND_OPTION;
+                        for(auto it = c->choices.begin(); it != c->choices.end(); ++it) {
+                                count(*it, kind, year);
+                        }
+                }
+        };
+
+        static const char *kindName(int kind) {
+                static const char *names[NUM_DEMAND_KINDS] = { "required", "option", "elective" };
+                return names[kind];
+        };
+
+        static std::string yearName(int year) {
+                if(year == 0) {
+                        return "unknown";
+                }
+                return std::to_string(year) + (year == MAX_YEAR ? "+" : "");
+        };
+
+        // the rows in order of total demand, largest first
+        std::vector<uint32_t> ranked() const {
+                std::vector<uint64_t> totals(keys.size(), 0);
+                for(uint32_t r = 0; r < keys.size(); ++r) {
+                        for(int kind = 0; kind < NUM_DEMAND_KINDS; ++kind) {
+                                totals[r] += getTotal(r, (DemandKind)kind);
+                        }
+                }
+                std::vector<uint32_t> order(keys.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                        return totals[a] != totals[b] ? totals[a] > totals[b] : keys[a] < keys[b];
+                });
+                return order;
+        };
+
+public:
+        DemandTable() {
+                std::fill(students, students + NUM_YEARS, 0);
+                this->unknownMajor = 0;
+                this->serial = 0;
+        };
+
+        // the year column of a student's year
+        static int yearColumn(int year) {
+                return (year < 1) ? 0 : std::min(year, MAX_YEAR);
+        };
+
+        // counts the courses an audited student still needs
+        void add(const AuditResult &r) {
+                if(!r.majorFound) {
+                        ++unknownMajor;
+                        return;
+                }
+                int year = yearColumn(r.year);
+                ++students[year];
+                ++serial;
+                countNeeds(r, year);
+        };
+
+        /*
+         * The same for a student with several majors, given their audit against each (see
+         * MultiMajorAudit). The student is counted once, and still at most once per course and
+         * kind whichever majors need it; they count as having an unknown major only if none
+         * of their majors were found.
+         */
+        void add(const std::vector<AuditResult> &majors) {
+                auto found = std::find_if(majors.begin(), majors.end(), [](const AuditResult &r) {
+                        return r.majorFound;
+                });
+                if(found == majors.end()) {
+                        ++unknownMajor;
+                        return;
+                }
+                int year = yearColumn(found->year);
+                ++students[year];
+                ++serial;
+                for(auto it = majors.begin(); it != majors.end(); ++it) {
+                        if(it->majorFound) {
+                                countNeeds(*it, year);
+                        }
+                }
+        };
+
+        // adds the counts of another table to this one
+        void merge(const DemandTable &other) {
+                for(uint32_t r = 0; r < other.keys.size(); ++r) {
+                        uint32_t mine = row(Course(0, other.names[r], other.keys[r]));
+                        for(int kind = 0; kind < NUM_DEMAND_KINDS; ++kind) {
+                                for(int year = 0; year < NUM_YEARS; ++year) {
+                                        counts[kind][year][mine] += other.counts[kind][year][r];
+                                }
+                        }
+                }
+                for(int year = 0; year < NUM_YEARS; ++year) {
+                        students[year] += other.students[year];
+                }
+                unknownMajor += other.unknownMajor;
+        };
+
+        size_t size() const {
+                return keys.size();
+        };
+
+        CourseKey getKey(size_t r) const {
+                return keys[r];
+        };
+
+        const std::string &getName(size_t r) const {
+                return names[r];
+        };
+
+        // students of a year column who need the course of a row
+        uint32_t get(size_t r, DemandKind kind, int year) const {
+                return counts[kind][year][r];
+        };
+
+        uint64_t getTotal(size_t r, DemandKind kind) const {
+                uint64_t total = 0;
+                for(int year = 0; year < NUM_YEARS; ++year) {
+                        total += counts[kind][year][r];
+                }
+                return total;
+        };
+
+        // students counted (those with an unknown major are not)
+        uint64_t getStudents() const {
+                return std::accumulate(students, students + NUM_YEARS, (uint64_t)0);
+        };
+
+        uint64_t getUnknownMajor() const {
+                return unknownMajor;
+        };
+
+        /*
+         * Writes the demand for every course, largest first, as text, JSON or CSV (one row per
+         * course, kind and year with any students).
+         */
+        void write(std::ostream &out, ReportFormat format) const {
+                std::vector<uint32_t> order = ranked();
+                if(format == REPORT_CSV) {
+                        out << "course,name,need,year,students\n";
+                } else if(format == REPORT_JSON) {
+                        out << "{\"students\":" << getStudents() << ",\"unknown_major\":" << unknownMajor
+                            << ",\"courses\":[";
+                } else {
+                        out << "Course demand of " << getStudents() << " students";
+                        if(unknownMajor > 0) {
+                                out << " (" << unknownMajor << " more with a major that could not be found)";
+                        }
+                        out << "\n";
+                }
+                for(auto it = order.begin(); it != order.end(); ++it) {
+                        uint32_t r = *it;
+                        std::string id = keys[r].toString();
+                        if(format == REPORT_JSON) {
+                                out << (it == order.begin() ? "" : ",") << "{\"course\":\"" << id
+                                    << "\",\"name\":" << ReportWriter::jsonString(names[r]);
+                        } else if(format == REPORT_TEXT) {
+                                out << "\n" << names[r] << " - " << id << "\n";
+                        }
+                        for(int kind = 0; kind < NUM_DEMAND_KINDS; ++kind) {
+                                uint64_t total = getTotal(r, (DemandKind)kind);
+                                if(format == REPORT_JSON) {
+                                        out << ",\"" << kindName(kind) << "\":{";
+                                } else if(format == REPORT_TEXT && total > 0) {
+                                        out << "   " << kindName(kind) << " by " << total << " students (";
+                                }
+                                bool first = true;
+                                for(int year = 0; year < NUM_YEARS && total > 0; ++year) {
+                                        uint32_t n = counts[kind][year][r];
+                                        if(n == 0) {
+                                                continue;
+                                        }
+                                        if(format == REPORT_CSV) {
+                                                out << id << "," << ReportWriter::csvField(names[r]) << ","
+                                                    << kindName(kind) << "," << yearName(year) << "," << n << "\n";
+                                        } else if(format == REPORT_JSON) {
+                                                out << (first ? "" : ",") << "\"" << yearName(year) << "\":" << n;
+                                        } else {
+                                                out << (first ? "" : ", ") << "year " << yearName(year) << ": " << n;
+                                        }
+                                        first = false;
+                                }
+                                if(format == REPORT_JSON) {
+                                        out << "}";
+                                } else if(format == REPORT_TEXT && total > 0) {
+                                        out << ")\n";
+                                }
+                        }
+                        if(format == REPORT_JSON) {
+                                out << "}";
+                        }
+                }
+                if(format == REPORT_JSON) {
+                        out << "]}\n";
+                }
+                out.flush();
+        };
+};
+
+#endif
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      CourseKey.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    A compact, fixed size id for a course. The listing and
+//                 course number of an id like "CS302" are packed into one
+//                 64 bit integer so courses can be compared and hashed
+//                 without touching strings.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CourseKey_hpp
+#define CourseKey_hpp
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cctype>
+#include <functional>
+
+/* Packs a course id into 64 bits:
+ *   bits 63-16: the listing, up to 8 characters of 6 bits each (first character highest)
+ *   bits 15-0:  the course number (0 - 65535)
+ * Listing characters may be letters, space, '&', '-' or '/'. Their codes follow ASCII
+ * order, so comparing two keys orders them by listing and then by number.
+ * A key of 0 is invalid - it is what parsing a malformed id produces.
+ */
+class CourseKey {
+
+private:
+        uint64_t key;
+
+        static const int MAX_LISTING = 8;
+        static const int NUMBER_BITS = 16;
+
+        // 6 bit code of a listing character (0 if the character is not allowed)
+        static uint64_t encode(char c) {
+                if(c >= 'A' && c <= 'Z') {
+                        return 5 + (c - 'A');
+                }
+                if(c >= 'a' && c <= 'z') {
+                        return 31 + (c - 'a');
+                }
+                switch(c) {
+                        case ' ': return 1;
+                        case '&': return 2;
+                        case '-': return 3;
+                        case '/': return 4;
+                }
+                return 0;
+        };
+
+        static char decode(uint64_t code) {
+                if(code >= 31) {
+                        return 'a' + (code - 31);
+                }
+                if(code >= 5) {
+                        return 'A' + (code - 5);
+                }
+                static const char symbols[] = { '\0', ' ', '&', '-', '/' };
+                return symbols[code];
+        };
+
+public:
+        CourseKey() {
+                this->key = 0;
+        };
+
+        explicit CourseKey(uint64_t key) {
+                this->key = key;
+        };
+
+        /*
+         * Builds the key of a listing and course number ("CS", 302).
+         * Returns an invalid key if the listing or number can not be packed.
+         */
+        static CourseKey make(std::string_view listing, int num) {
+                if(listing.empty() || listing.length() > MAX_LISTING || num < 0 || num >= (1 << NUMBER_BITS)) {
+                        return CourseKey();
+                }
+                uint64_t packed = 0;
+                for(int i = 0; i < MAX_LISTING; ++i) {
+                        uint64_t code = 0;
+                        if(i < (int)listing.length()) {
+                                code = encode(listing[i]);
+                                if(code == 0) {
+                                        return CourseKey();
+                                }
+                        }
+                        packed = (packed << 6) | code;
+                }
+                return CourseKey((packed << NUMBER_BITS) | (uint64_t)num);
+        };
+
+        /*
+         * Parses a course id of the form "CS302" (surrounding whitespace is ignored).
+         * Returns an invalid key if the id is not a listing followed by a number.
+         * Does not allocate.
+         */
+        static CourseKey parse(std::string_view id) {
+                std::string_view::size_type begin = 0, end = id.length();
+                while(begin < end && std::isspace((unsigned char)id[begin]) != 0) {
+                        ++begin;
+                }
+                while(end > begin && std::isspace((unsigned char)id[end - 1]) != 0) {
+                        --end;
+                }
+                // find where the number begins
+                std::string_view::size_type digits = begin;
+                while(digits < end && std::isdigit((unsigned char)id[digits]) == 0) {
+                        ++digits;
+                }
+                if(digits == begin || digits == end || end - digits > 5) {
+                        return CourseKey();
+                }
+                int num = 0;
+                for(std::string_view::size_type i = digits; i < end; ++i) {
+                        if(std::isdigit((unsigned char)id[i]) == 0) {
+                                return CourseKey();
+                        }
+                        num = num * 10 + (id[i] - '0');
+                }
+                return make(id.substr(begin, digits - begin), num);
+        };
+
+        bool isValid() const {
+                return key != 0;
+        };
+
+        uint64_t value() const {
+                return key;
+        };
+
+        int getNumber() const {
+                return (int)(key & ((1 << NUMBER_BITS) - 1));
+        };
+
+        std::string getListing() const {
+                std::string listing;
+                for(int i = MAX_LISTING - 1; i >= 0; --i) {
+                        uint64_t code = (key >> (NUMBER_BITS + 6 * i)) & 0x3f;
+                        if(code == 0) {
+                                break;
+                        }
+                        listing.push_back(decode(code));
+                }
+                return listing;
+        };
+
+        // the id in its usual form ("CS302"), empty for an invalid key
+        std::string toString() const {
+                if(!isValid()) {
+                        return "";
+                }
+                return getListing() + std::to_string(getNumber());
+        };
+
+        bool operator==(const CourseKey &other) const {
+                return key == other.key;
+        };
+
+        bool operator!=(const CourseKey &other) const {
+                return key != other.key;
+        };
+
+        bool operator<(const CourseKey &other) const {
+                return key < other.key;
+        };
+};
+
+namespace std {
+        template<> struct hash<CourseKey> {
+                size_t operator()(const CourseKey &k) const {
+                        // mix the bits so keys that only differ in the number spread out
+                        uint64_t x = k.value() * 0x9E3779B97F4A7C15ULL;
+                        return (size_t)(x ^ (x >> 32));
+                };
+        };
+}
+
+#endif
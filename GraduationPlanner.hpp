@@ -0,0 +1,469 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      GraduationPlanner.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Turns the outcome of an audit into a semester by semester
+//                 plan that finishes the major: the remaining required
+//                 courses, a choice for every open category and the
+//                 prerequisites they need, in as few semesters as possible
+//                 under a per semester credit cap.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GraduationPlanner_hpp
+#define GraduationPlanner_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <unordered_set>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "MajorRequirements.hpp"
+#include "AuditResult.hpp"
+#include "Prerequisites.hpp"
+#include "Metrics.hpp"
+
+/* Plans the semesters left to graduate.
+ * The courses to take are the remaining required courses, enough choices for every open
+ * category and every prerequisite of those not yet passed. A course can only be taken
+ * in a semester after all its prerequisites, and a semester holds at most creditCap
+ * credits.
+ * Which choices to take is found by branch and bound. Categories with the fewest
+ * candidates are decided first, and each category's candidates are tried cheapest first
+ * (the credits they add with their missing prerequisites), so the first plan found is
+ * already good. Each partial choice has a lower bound on the semesters it needs: the
+ * longest prerequisite chain among its courses and its credits over the cap. A branch
+ * is dropped once that bound can not beat the best plan so far (fewest semesters, then
+ * fewest credits). Each complete choice is laid out in semesters by list scheduling,
+ * taking the courses at the head of the longest chains first. At most nodeBudget partial
+ * choices are tried, which keeps a plan to a few milliseconds.
+ * Holds no state between plans, so one planner can be shared between threads.
+ */
+class GraduationPlanner {
+
+public:
+        static const int DEFAULT_CREDIT_CAP = 18;
+
+private:
+        int creditCap;
+        size_t maxCandidates;// per category, cheapest first
+        size_t nodeBudget;
+
+        // a course the plan could include
+        struct Node {
+                Course course;
+                std::vector<int> prerequisites;// not yet passed
+                std::vector<int> closure;// the node and every prerequisite it needs, in turn
+                int depth;// courses on the longest prerequisite chain ending with this one
+                bool blocked;// can never be taken (a prerequisite cycle or too many credits)
+        };
+
+        // a category still to fill and the courses that could fill it
+        struct Group {
+                std::string name;
+                int need;
+                std::vector<int> candidates;
+        };
+
+        // the state of planning one student
+        class Search {
+
+        private:
+                const GraduationPlanner &planner;
+                const PrerequisiteGraph &graph;
+                std::unordered_set<CourseKey> done;
+                std::unordered_map<CourseKey, Course> known;// course data from the audit
+                std::unordered_map<CourseKey, int> index;
+                std::vector<Node> nodes;
+                std::vector<int> state;// depth search: 0 new, 1 on the stack, 2 finished
+                std::vector<int> count;// closures of the chosen courses holding each node
+                std::vector<bool> taken;// chosen to fill a category
+                std::vector<Group> groups;
+                int credits, maxDepth;
+                size_t budget;
+                int bestSemesters, bestCredits, creditBound;
+                std::vector<std::vector<int> > best;
+
+                int node(CourseKey key) {
+                        auto found = index.find(key);
+                        if(found != index.end()) {
+                                return found->second;
+                        }
+                        int n = (int)nodes.size();
+                        index[key] = n;
+                        nodes.push_back(Node());
+                        state.push_back(0);
+                        auto data = known.find(key);
+                        auto stored = graph.courses.find(key);
+                        nodes[n].course = (data != known.end()) ? data->second
+                                          : (stored != graph.courses.end()) ? stored->second : Course(key);
+                        nodes[n].depth = 1;
+                        nodes[n].blocked = nodes[n].course.getCredits() > planner.creditCap;
+                        const std::vector<CourseKey> *prerequisites = graph.find(key);
+                        for(size_t i = 0; prerequisites && i < prerequisites->size(); ++i) {
+                                if(!done.count((*prerequisites)[i])) {
+                                        int p = node((*prerequisites)[i]);
+                                        nodes[n].prerequisites.push_back(p);
+                                }
+                        }
+                        return n;
+                };
+
+                // sets the depth of a node and blocks it if a prerequisite is blocked or cyclic
+                void measure(int n) {
+                        state[n] = 1;
+                        for(size_t i = 0; i < nodes[n].prerequisites.size(); ++i) {
+                                int p = nodes[n].prerequisites[i];
+                                if(state[p] == 1) {
+                                        nodes[n].blocked = true;// a cycle
+                                        continue;
+                                }
+                                if(state[p] == 0) {
+                                        measure(p);
+                                }
+                                nodes[n].blocked = nodes[n].blocked || nodes[p].blocked;
+                                nodes[n].depth = std::max(nodes[n].depth, nodes[p].depth + 1);
+                        }
+                        state[n] = 2;
+                };
+
+                const std::vector<int> &closure(int n) {
+                        Node &c = nodes[n];
+                        if(c.closure.empty()) {
+                                std::vector<bool> seen(nodes.size(), false);
+                                std::vector<int> stack(1, n);
+                                seen[n] = true;
+                                while(!stack.empty()) {
+                                        int top = stack.back();
+                                        stack.pop_back();
+                                        c.closure.push_back(top);
+                                        for(auto it = nodes[top].prerequisites.begin();
+                                            it != nodes[top].prerequisites.end(); ++it) {
+                                                if(!seen[*it]) {
+                                                        seen[*it] = true;
+                                                        stack.push_back(*it);
+                                                }
+                                        }
+                                }
+                        }
+                        return c.closure;
+                };
+
+                void add(int n) {
+                        const std::vector<int> &courses = closure(n);
+                        for(auto it = courses.begin(); it != courses.end(); ++it) {
+                                if(count[*it]++ == 0) {
+                                        credits += nodes[*it].course.getCredits();
+                                        maxDepth = std::max(maxDepth, nodes[*it].depth);
+                                }
+                        }
+                };
+
+                // the caller restores maxDepth
+                void remove(int n) {
+                        const std::vector<int> &courses = closure(n);
+                        for(auto it = courses.begin(); it != courses.end(); ++it) {
+                                if(--count[*it] == 0) {
+                                        credits -= nodes[*it].course.getCredits();
+                                }
+                        }
+                };
+
+                // fewest semesters the chosen courses could fit in
+                int bound(int depth, int total) const {
+                        return std::max(depth, (total + planner.creditCap - 1) / planner.creditCap);
+                };
+
+                // the credits a course adds to what is already chosen
+                int cost(int n) {
+                        int added = 0;
+                        const std::vector<int> &courses = closure(n);
+                        for(auto it = courses.begin(); it != courses.end(); ++it) {
+                                added += (count[*it] == 0) ? nodes[*it].course.getCredits() : 0;
+                        }
+                        return added;
+                };
+
+                // lays the chosen courses out in semesters, longest remaining chain first
+                std::vector<std::vector<int> > schedule() const {
+                        std::vector<int> members;
+                        for(size_t n = 0; n < nodes.size(); ++n) {
+                                if(count[n] > 0) {
+                                        members.push_back((int)n);
+                                }
+                        }
+                        // a course's prerequisites always have a smaller depth
+                        std::sort(members.begin(), members.end(), [this](int a, int b) {
+                                return nodes[a].depth > nodes[b].depth;
+                        });
+                        std::vector<int> height(nodes.size(), 1), waiting(nodes.size(), 0);
+                        std::vector<std::vector<int> > dependents(nodes.size());
+                        for(auto it = members.begin(); it != members.end(); ++it) {
+                                const std::vector<int> &prerequisites = nodes[*it].prerequisites;
+                                waiting[*it] = (int)prerequisites.size();
+                                for(auto p = prerequisites.begin(); p != prerequisites.end(); ++p) {
+                                        dependents[*p].push_back(*it);
+                                        height[*p] = std::max(height[*p], height[*it] + 1);
+                                }
+                        }
+
+                        std::vector<std::vector<int> > semesters;
+                        std::vector<int> ready;
+                        for(auto it = members.begin(); it != members.end(); ++it) {
+                                if(waiting[*it] == 0) {
+                                        ready.push_back(*it);
+                                }
+                        }
+                        while(!ready.empty()) {
+                                std::sort(ready.begin(), ready.end(), [&](int a, int b) {
+                                        if(height[a] != height[b]) {
+                                                return height[a] > height[b];
+                                        }
+                                        if(nodes[a].course.getCredits() != nodes[b].course.getCredits()) {
+                                                return nodes[a].course.getCredits() > nodes[b].course.getCredits();
+                                        }
+                                        return nodes[a].course.getKey() < nodes[b].course.getKey();
+                                });
+                                std::vector<int> semester, later;
+                                int load = 0;
+                                for(auto it = ready.begin(); it != ready.end(); ++it) {
+                                        if(load + nodes[*it].course.getCredits() <= planner.creditCap) {
+                                                load += nodes[*it].course.getCredits();
+                                                semester.push_back(*it);
+                                        } else {
+                                                later.push_back(*it);
+                                        }
+                                }
+                                for(auto it = semester.begin(); it != semester.end(); ++it) {
+                                        for(auto d = dependents[*it].begin(); d != dependents[*it].end(); ++d) {
+                                                if(--waiting[*d] == 0) {
+                                                        later.push_back(*d);
+                                                }
+                                        }
+                                }
+                                semesters.push_back(semester);
+                                ready.swap(later);
+                        }
+                        return semesters;
+                };
+
+                void leaf() {
+                        std::vector<std::vector<int> > semesters = schedule();
+                        int length = (int)semesters.size();
+                        if(length < bestSemesters || (length == bestSemesters && credits < bestCredits)) {
+                                bestSemesters = length;
+                                bestCredits = credits;
+                                best.swap(semesters);
+                        }
+                };
+
+                // true once the best plan can not be improved on
+                bool finished() const {
+                        return budget == 0 || (bestSemesters <= planner.lowerBound(*this) && bestCredits <= creditBound);
+                };
+
+                // chooses the remaining left courses of group g from its candidates at from or later
+                void explore(size_t g, size_t from, int left) {
+                        if(left == 0) {
+                                if(g + 1 < groups.size()) {
+                                        explore(g + 1, 0, groups[g + 1].need);
+                                } else {
+                                        leaf();
+                                }
+                                return;
+                        }
+                        const std::vector<int> &candidates = groups[g].candidates;
+                        for(size_t i = from; i < candidates.size() && !finished(); ++i) {
+                                int n = candidates[i];
+                                if(taken[n]) {
+                                        continue;// already counts for another category
+                                }
+                                --budget;
+                                int depth = maxDepth;
+                                taken[n] = true;
+                                add(n);
+                                int lower = bound(maxDepth, credits);
+                                if(lower < bestSemesters || (lower == bestSemesters && credits < bestCredits)) {
+                                        explore(g, i + 1, left - 1);
+                                }
+                                remove(n);
+                                taken[n] = false;
+                                maxDepth = depth;
+                        }
+                };
+
+        public:
+                int floorDepth, floorCredits;// lower bounds for the whole plan
+
+                Search(const GraduationPlanner &planner, const PrerequisiteGraph &graph)
+                        : planner(planner), graph(graph) {
+                        this->credits = 0;
+                        this->maxDepth = 0;
+                        this->budget = planner.nodeBudget;
+                        this->bestSemesters = INT_MAX;
+                        this->bestCredits = INT_MAX;
+                        this->creditBound = 0;
+                        this->floorDepth = 0;
+                        this->floorCredits = 0;
+                };
+
+                void run(const AuditResult &result, GraduationPlan &plan) {
+                        done.insert(result.completed.begin(), result.completed.end());
+                        for(auto it = result.requiredRemaining.begin(); it != result.requiredRemaining.end(); ++it) {
+                                known[it->getKey()] = *it;
+                        }
+                        for(auto c = result.getCategories().begin(); c != result.getCategories().end(); ++c) {
+                                for(auto it = c->choices.begin(); it != c->choices.end(); ++it) {
+                                        known[it->getKey()] = *it;
+                                }
+                        }
+
+                        // the required courses (and their prerequisites) are always taken
+                        std::vector<int> required;
+                        for(auto it = result.requiredRemaining.begin(); it != result.requiredRemaining.end(); ++it) {
+                                required.push_back(node(it->getKey()));
+                        }
+                        for(auto c = result.getCategories().begin(); c != result.getCategories().end(); ++c) {
+                                if(c->isComplete()) {
+                                        continue;
+                                }
+                                Group group;
+                                group.name = c->name;
+                                group.need = c->outstanding;
+                                for(auto it = c->choices.begin(); it != c->choices.end(); ++it) {
+                                        if(it->isValid() && !done.count(it->getKey())) {
+                                                group.candidates.push_back(node(it->getKey()));
+                                        }
+                                }
+                                groups.push_back(group);
+                        }
+                        for(size_t n = 0; n < nodes.size(); ++n) {
+                                if(state[n] == 0) {
+                                        measure((int)n);
+                                }
+                        }
+                        count.assign(nodes.size(), 0);
+                        taken.assign(nodes.size(), false);
+
+                        for(auto it = required.begin(); it != required.end(); ++it) {
+                                if(nodes[*it].blocked) {
+                                        plan.problem = nodes[*it].course.getCourseNum() + " can not be taken (a "
+                                                       "prerequisite chain is circular or over the credit cap)";
+                                        return;
+                                }
+                                add(*it);
+                        }
+                        floorDepth = maxDepth;
+                        floorCredits = credits;
+                        for(auto g = groups.begin(); g != groups.end(); ++g) {
+                                // cheapest candidates first, dropping those that can not be taken
+                                std::vector<std::pair<int, int> > ranked;// (cost, node)
+                                std::vector<int> depths, own;
+                                std::vector<bool> listed(nodes.size(), false);// drops duplicate choices
+                                for(auto it = g->candidates.begin(); it != g->candidates.end(); ++it) {
+                                        if(!nodes[*it].blocked && !listed[*it]) {
+                                                listed[*it] = true;
+                                                ranked.push_back(std::make_pair(cost(*it), *it));
+                                                depths.push_back(nodes[*it].depth);
+                                                own.push_back(count[*it] > 0 ? 0 : nodes[*it].course.getCredits());
+                                        }
+                                }
+                                if((int)ranked.size() < g->need) {
+                                        plan.problem = "only " + std::to_string(ranked.size()) + " of the " +
+                                                       std::to_string(g->need) + " courses still needed for " +
+                                                       g->name + " can be taken";
+                                        return;
+                                }
+                                std::sort(ranked.begin(), ranked.end(), [this](const std::pair<int, int> &a,
+                                                                               const std::pair<int, int> &b) {
+                                        if(a.first != b.first) {
+                                                return a.first < b.first;
+                                        }
+                                        if(nodes[a.second].depth != nodes[b.second].depth) {
+                                                return nodes[a.second].depth < nodes[b.second].depth;
+                                        }
+                                        return nodes[a.second].course.getKey() < nodes[b.second].course.getKey();
+                                });
+                                size_t keep = std::max((size_t)g->need, planner.maxCandidates);
+                                g->candidates.clear();
+                                for(size_t i = 0; i < ranked.size() && i < keep; ++i) {
+                                        g->candidates.push_back(ranked[i].second);
+                                }
+                                // whichever courses are chosen, the group adds at least its need-th
+                                // shortest chain and its need cheapest courses
+                                std::sort(depths.begin(), depths.end());
+                                std::sort(own.begin(), own.end());
+                                floorDepth = std::max(floorDepth, depths[g->need - 1]);
+                                for(int i = 0; i < g->need; ++i) {
+                                        floorCredits += own[i];
+                                }
+                        }
+                        creditBound = floorCredits;
+                        // the tightest categories are decided first
+                        std::stable_sort(groups.begin(), groups.end(), [](const Group &a, const Group &b) {
+                                return a.candidates.size() - a.need < b.candidates.size() - b.need;
+                        });
+
+                        if(groups.empty()) {
+                                leaf();
+                        } else {
+                                explore(0, 0, groups[0].need);
+                        }
+                        for(auto s = best.begin(); s != best.end(); ++s) {
+                                std::vector<Course> semester;
+                                for(auto it = s->begin(); it != s->end(); ++it) {
+                                        semester.push_back(nodes[*it].course);
+                                }
+                                std::sort(semester.begin(), semester.end());
+                                plan.semesters.push_back(semester);
+                        }
+                };
+        };
+
+        int lowerBound(const Search &search) const {
+                return std::max(search.floorDepth, (search.floorCredits + creditCap - 1) / creditCap);
+        };
+
+public:
+        GraduationPlanner(int creditCap = DEFAULT_CREDIT_CAP, size_t maxCandidates = 12, size_t nodeBudget = 4000) {
+                this->creditCap = creditCap;
+                this->maxCandidates = maxCandidates;
+                this->nodeBudget = nodeBudget;
+        };
+
+        int getCreditCap() const {
+                return creditCap;
+        };
+
+        /*
+         * Plans the semesters left for an audited student.
+         * The plan describes the problem instead if the major can not be finished: a
+         * required course that can never be taken, or a category without enough choices.
+         */
+        GraduationPlan plan(const AuditResult &result, const PrerequisiteGraph &graph) const {
+                static Histogram &planTime = Metrics::stage("plan");
+                ScopedTimer timer(planTime);
+                GraduationPlan plan;
+                plan.made = true;
+                plan.creditCap = creditCap;
+                if(!result.majorFound) {
+                        plan.problem = "the major " + result.major + " could not be found";
+                        return plan;
+                }
+                if(creditCap <= 0) {
+                        plan.problem = "the credit cap must be positive";
+                        return plan;
+                }
+                Search search(*this, graph);
+                search.run(result, plan);
+                plan.lowerBound = lowerBound(search);
+                return plan;
+        };
+};
+
+#endif
@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      InMemoryCatalogSource.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    A course catalog held in memory, read from a fixture file
+//                 or filled in by code. Lets audits run in process without
+//                 a database for tests, benchmarks and batch jobs.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef InMemoryCatalogSource_hpp
+#define InMemoryCatalogSource_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "MajorRequirements.hpp"
+#include "CatalogSource.hpp"
+
+/* Fixture files hold one record per line, with fields separated by '|' and course ids in
+ * a list separated by ','. Blank lines and lines starting with '#' are skipped.
+ *   version|VERSION
+ *   course|CS302|3|Introduction to Programming
+ *   major|Computer Science|3|CS                      (name, id, listing)
+ *   required|Computer Science|CS302,CS367
+ *   category|Computer Science|Calculus|2|MATH221,MATH222,MATH234
+ *   category|Computer Science|Electives|2
+ *   electives|CS|CS540,CS545,CS564
+ *   prereq|CS367|CS302                           (course, courses to pass first)
+ * A major must come before its required and category lines. Like the database, the choices
+ * of an Electives category are the electives of the major's listing.
+ *
+ * Nothing is locked: fill the source before sharing it between threads and only read it
+ * afterwards.
+ */
+class InMemoryCatalogSource : public CatalogSource {
+
+private:
+        std::string version;
+        std::map<std::string, MajorRequirements> majors;// courses only hold their ids
+        std::unordered_map<int, std::string> majorNames;// major id -> name
+        std::map<std::string, std::vector<Course> > electives;// listing -> electives
+        std::unordered_map<CourseKey, Course> courses;
+        std::unordered_map<CourseKey, std::vector<Course> > prerequisites;
+
+        static std::vector<std::string> split(const std::string &line, char separator) {
+                std::vector<std::string> fields;
+                std::string::size_type begin = 0;
+                while(true) {
+                        std::string::size_type end = line.find(separator, begin);
+                        fields.push_back(line.substr(begin, end - begin));
+                        if(end == std::string::npos) {
+                                return fields;
+                        }
+                        begin = end + 1;
+                }
+        };
+
+        // parses a list of course ids - false if one is not a valid id
+        static bool parseCourses(const std::string &list, std::vector<Course> &parsed) {
+                if(list.empty()) {
+                        return true;
+                }
+                std::vector<std::string> ids = split(list, ',');
+                for(auto it = ids.begin(); it != ids.end(); ++it) {
+                        Course c(*it);
+                        if(!c.isValid()) {
+                                return false;
+                        }
+                        parsed.push_back(c);
+                }
+                return true;
+        };
+
+        static bool parseInt(const std::string &s, int &value) {
+                char *end;
+                long parsed = std::strtol(s.c_str(), &end, 10);
+                if(s.empty() || *end != '\0') {
+                        return false;
+                }
+                value = (int)parsed;
+                return true;
+        };
+
+        // handles one fixture line - returns a description of the problem or "" if there is none
+        std::string parseLine(const std::string &line) {
+                std::vector<std::string> f = split(line, '|');
+                const std::string &kind = f[0];
+                if(kind == "version" && f.size() == 2) {
+                        version = f[1];
+                        return "";
+                }
+                if(kind == "course" && f.size() == 4) {
+                        int credits;
+                        Course c(f[1]);
+                        if(!c.isValid() || !parseInt(f[2], credits)) {
+                                return "bad course id or credits";
+                        }
+                        c.setName(f[3]);
+                        c.setCredits(credits);
+                        addCourse(c);
+                        return "";
+                }
+                if(kind == "major" && f.size() == 4) {
+                        MajorRequirements req;
+                        req.major = f[1];
+                        req.listing = f[3];
+                        if(!parseInt(f[2], req.id)) {
+                                return "bad major id";
+                        }
+                        if(majors.count(req.major) || majorNames.count(req.id)) {
+                                return "major " + req.major + " is defined twice";
+                        }
+                        addMajor(req);
+                        return "";
+                }
+                if(kind == "electives" && f.size() == 3) {
+                        std::vector<Course> list;
+                        if(!parseCourses(f[2], list)) {
+                                return "bad course id";
+                        }
+                        addElectives(f[1], list);
+                        return "";
+                }
+                if(kind == "prereq" && f.size() == 3) {
+                        Course c(f[1]);
+                        std::vector<Course> list;
+                        if(!c.isValid() || !parseCourses(f[2], list)) {
+                                return "bad course id";
+                        }
+                        addPrerequisites(c, list);
+                        return "";
+                }
+                if(kind != "required" && kind != "category") {
+                        return "unknown record \"" + kind + "\" or wrong number of fields";
+                }
+                auto major = (f.size() > 1) ? majors.find(f[1]) : majors.end();
+                if(major == majors.end()) {
+                        return "major is not defined before this line";
+                }
+                MajorRequirements &req = major->second;
+                if(kind == "required" && f.size() == 3) {
+                        return parseCourses(f[2], req.required) ? "" : "bad course id";
+                }
+                if(kind == "category" && (f.size() == 4 || f.size() == 5)) {
+                        OptionCategory category(f[2], 0);
+                        if(!parseInt(f[3], category.numRequired)) {
+                                return "bad number of courses required";
+                        }
+                        if(f.size() == 5 && category.name == "Electives") {
+                                return "the choices of Electives come from an electives line";
+                        }
+                        if(f.size() == 5 && !parseCourses(f[4], category.courses)) {
+                                return "bad course id";
+                        }
+                        req.categories.push_back(category);
+                        return "";
+                }
+                return "wrong number of fields";
+        };
+
+        const MajorRequirements *findMajor(int majorId) const {
+                auto name = majorNames.find(majorId);
+                return (name == majorNames.end()) ? NULL : &majors.find(name->second)->second;
+        };
+
+public:
+        InMemoryCatalogSource() {
+        };
+
+        /*
+         * Adds the records of a fixture file to the source.
+         * Returns false and describes the problem (with its line) in error if the file can not
+         * be read or is malformed.
+         */
+        bool load(const std::string &path, std::string &error) {
+                std::ifstream in(path);
+                if(!in) {
+                        error = "could not open fixture " + path;
+                        return false;
+                }
+                return load(in, path, error);
+        };
+
+        // the same for a stream - source names it in error
+        bool load(std::istream &in, const std::string &source, std::string &error) {
+                std::string line;
+                for(size_t lineNum = 1; getline(in, line); ++lineNum) {
+                        if(!line.empty() && line.back() == '\r') {
+                                line.pop_back();
+                        }
+                        if(line.empty() || line[0] == '#') {
+                                continue;
+                        }
+                        std::string problem = parseLine(line);
+                        if(!problem.empty()) {
+                                error = source + ":" + std::to_string(lineNum) + ": " + problem;
+                                return false;
+                        }
+                }
+                return true;
+        };
+
+        void setCatalogVersion(const std::string &version) {
+                this->version = version;
+        };
+
+        // adds a course or replaces its data
+        void addCourse(const Course &c) {
+                courses[c.getKey()] = c;
+        };
+
+        /*
+         * Adds a major (replacing one with the same name). Only the ids of the courses in req
+         * are kept - their data comes from addCourse.
+         */
+        void addMajor(const MajorRequirements &req) {
+                auto old = majors.find(req.major);
+                if(old != majors.end()) {
+                        majorNames.erase(old->second.id);
+                }
+                majors[req.major] = req;
+                majorNames[req.id] = req.major;
+        };
+
+        // sets the electives of a listing
+        void addElectives(const std::string &listing, const std::vector<Course> &list) {
+                electives[listing] = list;
+        };
+
+        // adds to the courses that must be passed before taking a course
+        void addPrerequisites(const Course &c, const std::vector<Course> &list) {
+                std::vector<Course> &known = prerequisites[c.getKey()];
+                known.insert(known.end(), list.begin(), list.end());
+        };
+
+        size_t getNumMajors() const {
+                return majors.size();
+        };
+
+        size_t getNumCourses() const {
+                return courses.size();
+        };
+
+        bool getMajorId(const std::string &major, int &id) override {
+                auto it = majors.find(major);
+                if(it == majors.end()) {
+                        return false;
+                }
+                id = it->second.id;
+                return true;
+        };
+
+        std::vector<Course> getRequiredCourses(int majorId) override {
+                const MajorRequirements *req = findMajor(majorId);
+                return req ? req->required : std::vector<Course>();
+        };
+
+        std::map<std::string, int> getMajorOptions(int majorId) override {
+                std::map<std::string, int> options;
+                const MajorRequirements *req = findMajor(majorId);
+                for(size_t i = 0; req && i < req->categories.size(); ++i) {
+                        options[req->categories[i].name] = req->categories[i].numRequired;
+                }
+                return options;
+        };
+
+        std::vector<Course> getOptionalElectives(const std::string &category, int majorId) override {
+                const MajorRequirements *req = findMajor(majorId);
+                for(size_t i = 0; req && i < req->categories.size(); ++i) {
+                        if(req->categories[i].name == category) {
+                                return req->categories[i].courses;
+                        }
+                }
+                return std::vector<Course>();
+        };
+
+        std::string getListing(int majorId) override {
+                const MajorRequirements *req = findMajor(majorId);
+                return req ? req->listing : "";
+        };
+
+        std::vector<Course> getElectives(const std::string &listing) override {
+                auto it = electives.find(listing);
+                return (it == electives.end()) ? std::vector<Course>() : it->second;
+        };
+
+        // courses the source does not know are left without data, like the database does
+        void getCourseData(std::vector<Course> &list) override {
+                for(auto it = list.begin(); it != list.end(); ++it) {
+                        auto found = courses.find(it->getKey());
+                        if(found != courses.end()) {
+                                it->setName(found->second.getName());
+                                it->setCredits(found->second.getCredits());
+                        }
+                }
+        };
+
+        std::string getCatalogVersion() override {
+                return version;
+        };
+
+        std::vector<Course> getPrerequisites(const Course &course) override {
+                auto it = prerequisites.find(course.getKey());
+                return (it == prerequisites.end()) ? std::vector<Course>() : it->second;
+        };
+
+        bool providesPrerequisites() override {
+                return true;
+        };
+};
+
+#endif
@@ -0,0 +1,370 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      IncrementalAudit.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Keeps a student's audit up to date as courses are added to
+//                 or removed from their transcript, redoing only the
+//                 requirements the changed courses touch instead of the
+//                 whole audit.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef IncrementalAudit_hpp
+#define IncrementalAudit_hpp
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include "CourseKey.hpp"
+#include "MajorRequirements.hpp"
+#include "AuditResult.hpp"
+#include "RequirementProgram.hpp"
+#include "Student.hpp"
+#include "Metrics.hpp"
+
+// which requirements of a major each course appears in (built once per major)
+struct RequirementIndex {
+        std::shared_ptr<const RequirementProgram> program;
+        std::shared_ptr<const MajorRequirements> req;
+        std::unordered_set<CourseKey> required;
+        std::unordered_map<CourseKey, std::vector<int> > categoriesOf;// categories listing the course
+
+        explicit RequirementIndex(std::shared_ptr<const RequirementProgram> program) {
+                this->program = program;
+                this->req = program->getRequirements();
+                for(auto it = req->required.begin(); it != req->required.end(); ++it) {
+                        required.insert((*it).getKey());
+                }
+                for(size_t c = 0; c < req->categories.size(); ++c) {
+                        const std::vector<Course> &choices = req->categories[c].courses;
+                        for(auto it = choices.begin(); it != choices.end(); ++it) {
+                                std::vector<int> &listed = categoriesOf[(*it).getKey()];
+                                if(listed.empty() || listed.back() != (int)c) {
+                                        listed.push_back((int)c);
+                                }
+                        }
+                }
+        };
+};
+
+/* The audit of one student together with the state needed to update it: how many times
+ * each course is on the transcript and the courses used for each category (kept in the
+ * AuditResult).
+ * apply() only redoes the requirements a change touches. The required courses are split
+ * again only if a changed course is required. Categories are matched again only in the
+ * groups linked to a changed course through shared completed courses, since groups that
+ * share no course can not affect each other. The result is always the same as a full audit
+ * of the changed transcript.
+ * Not safe to share between threads.
+ */
+class IncrementalAudit {
+
+private:
+        std::shared_ptr<const RequirementIndex> index;
+        std::unordered_map<CourseKey, int> counts;// times each course is on the transcript
+        AuditResult result;
+
+        // a course counts once it is on the transcript at least once
+        bool isDone(CourseKey key) const {
+                auto it = counts.find(key);
+                return it != counts.end() && it->second > 0;
+        };
+
+        static int find(std::vector<int> &parent, int c) {
+                while(parent[c] != c) {
+                        parent[c] = parent[parent[c]];
+                        c = parent[c];
+                }
+                return c;
+        };
+
+public:
+        // audits the student from scratch
+        IncrementalAudit(Student &student, std::shared_ptr<const RequirementIndex> index) {
+                this->index = index;
+                this->result = student.audit(*index->program);
+                for(auto it = result.completed.begin(); it != result.completed.end(); ++it) {
+                        ++counts[*it];
+                }
+        };
+
+        // starts from an audit of the student made elsewhere (eg. by the AuditCache)
+        IncrementalAudit(const AuditResult &result, std::shared_ptr<const RequirementIndex> index) {
+                this->index = index;
+                this->result = result;
+                for(auto it = result.completed.begin(); it != result.completed.end(); ++it) {
+                        ++counts[*it];
+                }
+        };
+
+        const AuditResult &getResult() const {
+                return result;
+        };
+
+        std::shared_ptr<const MajorRequirements> getRequirements() const {
+                return index->req;
+        };
+
+        /*
+         * Adds courses to and removes courses from the transcript and updates the audit.
+         * Removing a course that is not on the transcript does nothing.
+         * Returns the number of requirements redone (the required courses count as one).
+         */
+        size_t apply(const std::vector<CourseKey> &added, const std::vector<CourseKey> &removed) {
+                static Histogram &reauditTime = Metrics::stage("reaudit");
+                ScopedTimer timer(reauditTime);
+                const MajorRequirements &req = *index->req;
+
+                // update the transcript and note the courses that started or stopped counting
+                std::vector<CourseKey> changed;
+                for(auto it = added.begin(); it != added.end(); ++it) {
+                        if(!it->isValid()) {
+                                continue;
+                        }
+                        if(counts[*it]++ == 0) {
+                                changed.push_back(*it);
+                        }
+                        result.completed.push_back(*it);
+                }
+                for(auto it = removed.begin(); it != removed.end(); ++it) {
+                        auto pos = std::find(result.completed.begin(), result.completed.end(), *it);
+                        if(pos == result.completed.end()) {
+                                continue;
+                        }
+                        result.completed.erase(pos);
+                        if(--counts[*it] == 0) {
+                                changed.push_back(*it);
+                        }
+                }
+
+                size_t redone = 0;
+                bool requiredTouched = false;
+                std::vector<int> parent(req.categories.size());
+                std::iota(parent.begin(), parent.end(), 0);
+                std::vector<bool> seeded(req.categories.size(), false);
+                for(auto it = changed.begin(); it != changed.end(); ++it) {
+                        requiredTouched = requiredTouched || index->required.count(*it) != 0;
+                        auto listed = index->categoriesOf.find(*it);
+                        if(listed != index->categoriesOf.end()) {
+                                for(auto c = listed->second.begin(); c != listed->second.end(); ++c) {
+                                        seeded[*c] = true;
+                                }
+                        }
+                }
+
+                if(requiredTouched) {
+                        ++redone;
+                        result.requiredCompleted.clear();
+                        result.requiredRemaining.clear();
+                        for(auto it = req.required.begin(); it != req.required.end(); ++it) {
+                                if(isDone((*it).getKey())) {
+                                        result.requiredCompleted.push_back(*it);
+                                } else {
+                                        result.requiredRemaining.push_back(*it);
+                                }
+                        }
+                }
+
+                // group the categories linked through completed courses and redo every group
+                // holding a category that lists a changed course
+                std::vector<CourseKey> done;
+                for(auto it = counts.begin(); it != counts.end(); ++it) {
+                        if(it->second <= 0) {
+                                continue;
+                        }
+                        done.push_back(it->first);
+                        auto listed = index->categoriesOf.find(it->first);
+                        if(listed == index->categoriesOf.end()) {
+                                continue;
+                        }
+                        for(auto c = listed->second.begin() + 1; c < listed->second.end(); ++c) {
+                                parent[find(parent, *c)] = find(parent, listed->second.front());
+                        }
+                }
+                std::vector<bool> affected(req.categories.size(), false);
+                for(size_t c = 0; c < req.categories.size(); ++c) {
+                        if(seeded[c]) {
+                                affected[find(parent, (int)c)] = true;
+                        }
+                }
+                std::vector<int> group;
+                for(size_t c = 0; c < req.categories.size(); ++c) {
+                        if(affected[find(parent, (int)c)]) {
+                                group.push_back((int)c);
+                        }
+                }
+
+                // match the affected groups again
+                if(!group.empty()) {
+                        index->program->rematch(group, done, result.editCategories());
+                        redone += group.size();
+                }
+                return redone;
+        };
+};
+
+/* The audits kept by the audit server so a later request can send only the courses that
+ * changed. Audits are kept by student id, at most maxAudits of them: the least recently
+ * used are dropped first (the client then sends the whole transcript again, as it does for
+ * a student never audited). Like the RequirementsCache the store remembers the catalog
+ * version and drops every audit when it changes.
+ * Each kept audit has a lock of its own. The store's lock is only held to find or replace
+ * an audit, so changes for different students are applied at the same time. A change
+ * applied while the student's audit is being replaced or dropped still gets its result,
+ * but is lost with the old audit.
+ * Safe to share between threads.
+ */
+class AuditStore {
+
+public:
+        static const size_t DEFAULT_MAX_AUDITS = 1 << 16;
+
+private:
+        struct Kept {
+                std::mutex lock;
+                IncrementalAudit audit;
+
+                explicit Kept(IncrementalAudit &&audit) : audit(std::move(audit)) {
+                };
+        };
+
+        struct Entry {
+                std::shared_ptr<Kept> kept;
+                std::list<std::string>::iterator used;// place in order
+        };
+
+        std::unordered_map<std::string, Entry> audits;
+        std::list<std::string> order;// ids, most recently used first
+        std::unordered_map<std::string, std::shared_ptr<const RequirementIndex> > indexes;// by major
+        size_t maxAudits;
+        unsigned long evictions;
+        std::string version;
+        mutable std::mutex lock;
+
+        // the index of a major's requirements, made again if they were reloaded
+        std::shared_ptr<const RequirementIndex> getIndex(const std::shared_ptr<const RequirementProgram> &program) {
+                std::lock_guard<std::mutex> guard(lock);
+                std::shared_ptr<const RequirementIndex> &known = indexes[program->getMajor()];
+                if(!known || known->program != program) {
+                        known.reset(new RequirementIndex(program));
+                }
+                return known;
+        };
+
+        // keeps an audit under id, dropping the least recently used audits if there are too many
+        void put(const std::string &id, std::shared_ptr<Kept> kept) {
+                std::lock_guard<std::mutex> guard(lock);
+                if(maxAudits == 0) {
+                        return;
+                }
+                auto found = audits.find(id);
+                if(found != audits.end()) {
+                        order.splice(order.begin(), order, found->second.used);
+                        found->second.kept = std::move(kept);
+                        return;
+                }
+                order.push_front(id);
+                Entry &entry = audits[id];
+                entry.kept = std::move(kept);
+                entry.used = order.begin();
+                while(audits.size() > maxAudits) {
+                        audits.erase(order.back());
+                        order.pop_back();
+                        ++evictions;
+                }
+        };
+
+public:
+        explicit AuditStore(size_t maxAudits = DEFAULT_MAX_AUDITS) {
+                this->maxAudits = maxAudits;
+                this->evictions = 0;
+        };
+
+        AuditStore(const AuditStore &) = delete;
+        AuditStore &operator=(const AuditStore &) = delete;
+
+        /*
+         * Audits a student from scratch, keeps the audit and returns its result.
+         */
+        AuditResult audit(Student &student, std::shared_ptr<const RequirementProgram> program) {
+                std::shared_ptr<Kept> kept(new Kept(IncrementalAudit(student, getIndex(program))));
+                AuditResult result = kept->audit.getResult();
+                put(student.getId(), std::move(kept));
+                return result;
+        };
+
+        /*
+         * Keeps an audit made elsewhere (result.completed must hold the whole transcript) so
+         * the student can send changes to it later.
+         */
+        void keep(const AuditResult &result, std::shared_ptr<const RequirementProgram> program) {
+                put(result.id, std::shared_ptr<Kept>(new Kept(IncrementalAudit(result, getIndex(program)))));
+        };
+
+        // drops the kept audit of a student (if any), so changes sent for them are refused
+        void forget(const std::string &id) {
+                std::lock_guard<std::mutex> guard(lock);
+                auto found = audits.find(id);
+                if(found != audits.end()) {
+                        order.erase(found->second.used);
+                        audits.erase(found);
+                }
+        };
+
+        /*
+         * Applies a change to the kept audit of a student and copies the updated result.
+         * Returns false if no audit of the student is kept.
+         */
+        bool apply(const std::string &id, const std::vector<CourseKey> &added,
+                   const std::vector<CourseKey> &removed, AuditResult &result) {
+                std::shared_ptr<Kept> kept;
+                {
+                        std::lock_guard<std::mutex> guard(lock);
+                        auto found = audits.find(id);
+                        if(found == audits.end()) {
+                                return false;
+                        }
+                        order.splice(order.begin(), order, found->second.used);
+                        kept = found->second.kept;
+                }
+                std::lock_guard<std::mutex> guard(kept->lock);
+                kept->audit.apply(added, removed);
+                result = kept->audit.getResult();
+                return true;
+        };
+
+        // drops every audit if the catalog version changed (true if any were dropped)
+        bool checkVersion(const std::string &current) {
+                std::lock_guard<std::mutex> guard(lock);
+                if(current == version) {
+                        return false;
+                }
+                version = current;
+                bool stale = !audits.empty();
+                audits.clear();
+                order.clear();
+                indexes.clear();
+                return stale;
+        };
+
+        size_t size() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return audits.size();
+        };
+
+        void printStats(std::ostream &out) const {
+                std::lock_guard<std::mutex> guard(lock);
+                out << "Audit store: " << audits.size() << " of " << maxAudits << " audits kept for "
+                    << indexes.size() << " majors, " << evictions << " evicted" << std::endl;
+        };
+};
+
+#endif
@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MajorRequirements.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Holds everything a major requires to graduate: the
+//                 absolutely required courses and the option categories
+//                 a student picks courses from. Filled from the database
+//                 or from a catalog snapshot before a student is audited.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MajorRequirements_hpp
+#define MajorRequirements_hpp
+
+#include <string>
+#include <vector>
+#include "Course.hpp"
+
+// an option category (eg. "Electives") - numRequired of the courses must be taken
+struct OptionCategory {
+        std::string name;
+        int numRequired;
+        std::vector<Course> courses;
+        bool pooled;// true if the courses only hold their ids (see CatalogSource::setLazyElectives)
+
+        OptionCategory() {
+                this->numRequired = 0;
+                this->pooled = false;
+        };
+
+        OptionCategory(std::string name, int numRequired) {
+                this->name = name;
+                this->numRequired = numRequired;
+                this->pooled = false;
+        };
+};
+
+/* The requirements of one major.
+ * The categories are kept in the order they are audited in. The Electives category
+ * (if the major has one) is always last so courses are not used to fulfill electives
+ * before the other requirements.
+ */
+struct MajorRequirements {
+        int id;
+        std::string major, listing;
+        std::vector<Course> required;// courses absolutely required to graduate
+        std::vector<OptionCategory> categories;
+
+        MajorRequirements() {
+                this->id = 0;
+        };
+};
+
+#endif
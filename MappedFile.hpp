@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MappedFile.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    A read only file mapped into memory. The mapping is
+//                 released when the MappedFile is destroyed.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <string>
+#include <cstddef>
+
+// include posix headers for memory mapping
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class MappedFile {
+
+private:
+        const char *data;
+        size_t size;
+        bool mapped;// false for an empty file (nothing to unmap)
+
+public:
+        MappedFile() {
+                this->data = NULL;
+                this->size = 0;
+                this->mapped = false;
+        };
+
+        ~MappedFile() {
+                close();
+        };
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /*
+         * Maps the whole file into memory. Pass sequential if the file will be read front to back.
+         * Returns false and describes the problem in error if the file can not be mapped.
+         */
+        bool open(const std::string &path, std::string &error, bool sequential = false) {
+                close();
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if(fd < 0) {
+                        error = "could not open " + path;
+                        return false;
+                }
+                struct stat info;
+                if(fstat(fd, &info) != 0) {
+                        ::close(fd);
+                        error = "could not read " + path;
+                        return false;
+                }
+                if(info.st_size == 0) {
+                        ::close(fd);
+                        data = "";
+                        return true;
+                }
+                void *region = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);// the mapping stays valid after the file is closed
+                if(region == MAP_FAILED) {
+                        error = "could not map " + path;
+                        return false;
+                }
+                if(sequential) {
+                        madvise(region, info.st_size, MADV_SEQUENTIAL);
+                }
+                data = (const char *)region;
+                size = info.st_size;
+                mapped = true;
+                return true;
+        };
+
+        void close() {
+                if(mapped) {
+                        munmap((void *)data, size);
+                }
+                data = NULL;
+                size = 0;
+                mapped = false;
+        };
+
+        bool isOpen() const {
+                return data != NULL;
+        };
+
+        const char *getData() const {
+                return data;
+        };
+
+        size_t getSize() const {
+                return size;
+        };
+};
+
+#endif
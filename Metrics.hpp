@@ -0,0 +1,336 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      Metrics.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Process wide counters and latency histograms for the hot
+//                 paths (audit stages, database calls), printed as a summary
+//                 or written in the Prometheus text format. Off unless
+//                 enabled, in which case recording costs one flag check.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef Metrics_hpp
+#define Metrics_hpp
+
+#include <string>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+// a count that only goes up
+class Counter {
+
+private:
+        std::atomic<uint64_t> value;
+
+public:
+        Counter() : value(0) {
+        };
+
+        // adds n if metrics are enabled (defined after Metrics)
+        void add(uint64_t n = 1);
+
+        uint64_t get() const {
+                return value.load(std::memory_order_relaxed);
+        };
+};
+
+/* Latency histogram with fixed buckets from 1 us to 10 s (1-2.5-5 steps) plus one for
+ * anything slower. Recording is lock free.
+ */
+class Histogram {
+
+public:
+        static const int NUM_BOUNDS = 22;
+
+        // upper bound (seconds) of each bucket but the last
+        static double bound(int i) {
+                static const double bounds[NUM_BOUNDS] = {
+                        0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025,
+                        0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+                };
+                return bounds[i];
+        };
+
+private:
+        std::atomic<uint64_t> buckets[NUM_BOUNDS + 1];
+        std::atomic<uint64_t> count, sumNanos, maxNanos;
+
+public:
+        Histogram() : count(0), sumNanos(0), maxNanos(0) {
+                for(int i = 0; i <= NUM_BOUNDS; ++i) {
+                        buckets[i].store(0, std::memory_order_relaxed);
+                }
+        };
+
+        void observe(double seconds) {
+                int i = 0;
+                while(i < NUM_BOUNDS && seconds > bound(i)) {
+                        ++i;
+                }
+                uint64_t nanos = (uint64_t)(seconds * 1e9);
+                buckets[i].fetch_add(1, std::memory_order_relaxed);
+                count.fetch_add(1, std::memory_order_relaxed);
+                sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+                uint64_t longest = maxNanos.load(std::memory_order_relaxed);
+                while(nanos > longest && !maxNanos.compare_exchange_weak(longest, nanos)) {
+                }
+        };
+
+        uint64_t getCount() const {
+                return count.load(std::memory_order_relaxed);
+        };
+
+        uint64_t getBucket(int i) const {
+                return buckets[i].load(std::memory_order_relaxed);
+        };
+
+        double getSum() const {
+                return sumNanos.load(std::memory_order_relaxed) / 1e9;
+        };
+
+        double getMax() const {
+                return maxNanos.load(std::memory_order_relaxed) / 1e9;
+        };
+
+        // the upper bound of the bucket holding quantile q (0..1) - max for the last bucket
+        double quantile(double q) const {
+                uint64_t total = getCount(), seen = 0;
+                for(int i = 0; i < NUM_BOUNDS; ++i) {
+                        seen += getBucket(i);
+                        if(total > 0 && seen >= q * total) {
+                                return std::min(bound(i), getMax());
+                        }
+                }
+                return getMax();
+        };
+};
+
+/* The registry of every counter and histogram, by metric name and label set
+ * ("stage=\"match\""). Metrics are created on first use and live as long as the process,
+ * so hot paths look them up once and keep the reference (a function level static):
+ *
+ *   static Counter &audits = Metrics::instance().counter("course_guide_audits_total",
+ *                                                        "Students audited");
+ *   static Histogram &matchTime = Metrics::stage("match");
+ *   ScopedTimer timer(matchTime);
+ *   audits.add();
+ *
+ * Nothing is recorded until enable() is called. Safe to share between threads.
+ */
+class Metrics {
+
+private:
+        struct Family {
+                std::string help;
+                std::map<std::string, std::unique_ptr<Counter> > counters;// by labels
+                std::map<std::string, std::unique_ptr<Histogram> > histograms;
+        };
+
+        std::map<std::string, Family> families;// by metric name
+        mutable std::mutex lock;
+
+        Metrics() {
+        };
+
+        static std::atomic<bool> &flag() {
+                static std::atomic<bool> on(false);
+                return on;
+        };
+
+        static std::string withLabels(const std::string &name, const std::string &labels,
+                                      const std::string &extra = "") {
+                std::string all = labels;
+                if(!extra.empty()) {
+                        all += (all.empty() ? "" : ",") + extra;
+                }
+                return all.empty() ? name : name + "{" + all + "}";
+        };
+
+public:
+        static Metrics &instance() {
+                static Metrics metrics;
+                return metrics;
+        };
+
+        Metrics(const Metrics &) = delete;
+        Metrics &operator=(const Metrics &) = delete;
+
+        // true if metrics are being recorded (one relaxed load - cheap enough for any hot path)
+        static bool enabled() {
+                return flag().load(std::memory_order_relaxed);
+        };
+
+        static void enable(bool on = true) {
+                flag().store(on, std::memory_order_relaxed);
+        };
+
+        // a label set holding one label, with the value escaped for the Prometheus format
+        static std::string label(const std::string &name, const std::string &value) {
+                std::string escaped;
+                for(auto it = value.begin(); it != value.end(); ++it) {
+                        if(*it == '\\' || *it == '"') {
+                                escaped.push_back('\\');
+                        }
+                        if(*it == '\n') {
+                                escaped.append("\\n");
+                        } else {
+                                escaped.push_back(*it);
+                        }
+                }
+                return name + "=\"" + escaped + "\"";
+        };
+
+        Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "") {
+                std::lock_guard<std::mutex> guard(lock);
+                Family &family = families[name];
+                family.help = help;
+                std::unique_ptr<Counter> &c = family.counters[labels];
+                if(!c) {
+                        c.reset(new Counter());
+                }
+                return *c;
+        };
+
+        Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = "") {
+                std::lock_guard<std::mutex> guard(lock);
+                Family &family = families[name];
+                family.help = help;
+                std::unique_ptr<Histogram> &h = family.histograms[labels];
+                if(!h) {
+                        h.reset(new Histogram());
+                }
+                return *h;
+        };
+
+        // the histogram of one audit stage (parse, requirements, audit, match, report)
+        static Histogram &stage(const std::string &name) {
+                return instance().histogram("course_guide_stage_seconds", "Time spent in each stage of an audit",
+                                            label("stage", name));
+        };
+
+        // writes every metric in the Prometheus text exposition format
+        void writePrometheus(std::ostream &out) const {
+                std::lock_guard<std::mutex> guard(lock);
+                std::streamsize precision = out.precision();
+                out << std::setprecision(9);
+                for(auto f = families.begin(); f != families.end(); ++f) {
+                        const std::string &name = f->first;
+                        const Family &family = f->second;
+                        out << "# HELP " << name << " " << family.help << "\n";
+                        out << "# TYPE " << name << (family.histograms.empty() ? " counter" : " histogram") << "\n";
+                        for(auto it = family.counters.begin(); it != family.counters.end(); ++it) {
+                                out << withLabels(name, it->first) << " " << it->second->get() << "\n";
+                        }
+                        for(auto it = family.histograms.begin(); it != family.histograms.end(); ++it) {
+                                const Histogram &h = *it->second;
+                                uint64_t cumulative = 0;
+                                for(int i = 0; i < Histogram::NUM_BOUNDS; ++i) {
+                                        cumulative += h.getBucket(i);
+                                        std::ostringstream le;
+                                        le << "le=\"" << Histogram::bound(i) << "\"";
+                                        out << withLabels(name + "_bucket", it->first, le.str()) << " " << cumulative << "\n";
+                                }
+                                out << withLabels(name + "_bucket", it->first, "le=\"+Inf\"") << " " << h.getCount() << "\n";
+                                out << withLabels(name + "_sum", it->first) << " " << h.getSum() << "\n";
+                                out << withLabels(name + "_count", it->first) << " " << h.getCount() << "\n";
+                        }
+                }
+                out << std::setprecision(precision);
+                out.flush();
+        };
+
+        /*
+         * Writes every metric to a file in the Prometheus text format (for the node exporter's
+         * textfile collector). The file is replaced in one step so a scrape never sees half of it.
+         * Returns false and describes the problem in error if it could not be written.
+         */
+        bool writePrometheus(const std::string &path, std::string &error) const {
+                std::string tmp = path + ".tmp";
+                {
+                        std::ofstream out(tmp);
+                        writePrometheus(out);
+                        if(!out) {
+                                error = "could not write metrics to " + tmp;
+                                return false;
+                        }
+                }
+                if(std::rename(tmp.c_str(), path.c_str()) != 0) {
+                        error = "could not replace " + path;
+                        return false;
+                }
+                return true;
+        };
+
+        // prints a human readable summary of every metric that has recorded something
+        void printSummary(std::ostream &out) const {
+                std::lock_guard<std::mutex> guard(lock);
+                std::streamsize precision = out.precision();
+                out << "Metrics:" << std::endl << std::fixed << std::setprecision(3);
+                for(auto f = families.begin(); f != families.end(); ++f) {
+                        const Family &family = f->second;
+                        for(auto it = family.counters.begin(); it != family.counters.end(); ++it) {
+                                if(it->second->get() > 0) {
+                                        out << "  " << withLabels(f->first, it->first) << ": "
+                                            << it->second->get() << std::endl;
+                                }
+                        }
+                        for(auto it = family.histograms.begin(); it != family.histograms.end(); ++it) {
+                                const Histogram &h = *it->second;
+                                if(h.getCount() == 0) {
+                                        continue;
+                                }
+                                out << "  " << withLabels(f->first, it->first) << ": " << h.getCount() << " times, "
+                                    << h.getSum() * 1000 << " ms total, " << h.getSum() * 1000 / h.getCount()
+                                    << " ms avg, p50 <= " << h.quantile(0.5) * 1000 << " ms, p99 <= "
+                                    << h.quantile(0.99) * 1000 << " ms, " << h.getMax() * 1000 << " ms max" << std::endl;
+                        }
+                }
+                out << std::defaultfloat << std::setprecision(precision);
+        };
+};
+
+inline void Counter::add(uint64_t n) {
+        if(Metrics::enabled()) {
+                value.fetch_add(n, std::memory_order_relaxed);
+        }
+}
+
+/* Records the time from construction to destruction in a histogram. When metrics are off
+ * the clock is not read at all.
+ */
+class ScopedTimer {
+
+private:
+        Histogram *histogram;
+        std::chrono::steady_clock::time_point start;
+
+public:
+        explicit ScopedTimer(Histogram &histogram) {
+                this->histogram = Metrics::enabled() ? &histogram : NULL;
+                if(this->histogram) {
+                        this->start = std::chrono::steady_clock::now();
+                }
+        };
+
+        ~ScopedTimer() {
+                if(histogram) {
+                        histogram->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                }
+        };
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+#endif
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MultiMajorAudit.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Audits a student with several majors (or certificates) in
+//                 one go, deciding which completed courses may count for
+//                 more than one of them.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MultiMajorAudit_hpp
+#define MultiMajorAudit_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+#include "CourseKey.hpp"
+#include "AuditResult.hpp"
+#include "RequirementProgram.hpp"
+
+/* Which courses may count for more than one major of a student.
+ * A required course always counts for every major that requires it. A course counted by
+ * one major may also fill a category of another, at most maxShared times per student, but
+ * never when either category is exclusive (eg. "Electives" so each major's electives are
+ * its own).
+ */
+struct OverlapRules {
+        int maxShared;// courses filling a category of more than one major (-1 for no limit)
+        std::unordered_set<std::string> exclusive;// categories that never share a course
+
+        OverlapRules() {
+                this->maxShared = -1;
+        };
+};
+
+/* The majors are audited in the order listed, so the first gets the first claim on every
+ * course. Each major after it is audited with the courses the earlier majors count held
+ * back from its categories; once the rest are placed, the ones the rules let it share are
+ * offered to its categories one at a time and kept only if they fill one more course (see
+ * RequirementProgram::audit). So a course is only shared when no course of its own would
+ * do, and the limit on sharing goes to the first majors that need it.
+ * The student's transcript is read and the requirements of each major are loaded and
+ * compiled once for all of them (see RequirementsCache), so auditing n majors costs n
+ * audits - not n runs of the whole tool.
+ * Holds no state besides the rules, so it can be shared between threads.
+ */
+class MultiMajorAudit {
+
+private:
+        OverlapRules rules;
+
+public:
+        explicit MultiMajorAudit(const OverlapRules &rules = OverlapRules()) {
+                this->rules = rules;
+        };
+
+        const OverlapRules &getRules() const {
+                return rules;
+        };
+
+        /*
+         * Audits a student against each of their majors. student holds their info and
+         * completed courses (see Student::newResult); programs[i] holds the requirements of
+         * majors[i], or is null if that major could not be found (it is reported as unknown).
+         * Returns one result per major, in the same order, each listing the other majors and
+         * the courses it shares with them.
+         */
+        std::vector<AuditResult> audit(const AuditResult &student, const std::vector<std::string> &majors,
+                                       const std::vector<std::shared_ptr<const RequirementProgram> > &programs) const {
+                std::vector<AuditResult> results;
+                // courses counted by the majors audited so far (true if an exclusive category uses it)
+                std::unordered_map<CourseKey, bool> counted;
+                int allowance = rules.maxShared;
+                for(size_t i = 0; i < majors.size() && i < programs.size(); ++i) {
+                        AuditResult base(student);
+                        base.major = majors[i];
+                        if(!programs[i]) {
+                                results.push_back(std::move(base));// reports the unknown major
+                                continue;
+                        }
+                        // courses an exclusive category counts can not be shared at all
+                        std::unordered_map<CourseKey, CourseClaim> claims;
+                        for(auto it = counted.begin(); it != counted.end(); ++it) {
+                                claims[it->first] = it->second ? CLAIM_HELD : CLAIM_SHARED;
+                        }
+                        AuditResult result = programs[i]->audit(std::move(base), claims, rules.exclusive, allowance);
+
+                        for(auto it = result.requiredCompleted.begin(); it != result.requiredCompleted.end(); ++it) {
+                                counted.insert(std::make_pair((*it).getKey(), false));
+                        }
+                        for(auto c = result.getCategories().begin(); c != result.getCategories().end(); ++c) {
+                                bool exclusive = rules.exclusive.count(c->name) != 0;
+                                for(auto it = c->used.begin(); it != c->used.end(); ++it) {
+                                        counted[*it] = counted[*it] || exclusive;
+                                }
+                        }
+                        results.push_back(std::move(result));
+                }
+
+                // how many majors count each course
+                std::unordered_map<CourseKey, int> majorsCounting;
+                std::vector<std::unordered_set<CourseKey> > countedBy(results.size());
+                for(size_t i = 0; i < results.size(); ++i) {
+                        const AuditResult &r = results[i];
+                        for(auto it = r.requiredCompleted.begin(); it != r.requiredCompleted.end(); ++it) {
+                                countedBy[i].insert((*it).getKey());
+                        }
+                        for(auto c = r.getCategories().begin(); c != r.getCategories().end(); ++c) {
+                                countedBy[i].insert(c->used.begin(), c->used.end());
+                        }
+                        for(auto it = countedBy[i].begin(); it != countedBy[i].end(); ++it) {
+                                ++majorsCounting[*it];
+                        }
+                }
+                for(size_t i = 0; i < results.size(); ++i) {
+                        AuditResult &r = results[i];
+                        for(size_t j = 0; j < majors.size(); ++j) {
+                                if(j != i) {
+                                        r.otherMajors.push_back(majors[j]);
+                                }
+                        }
+                        std::unordered_set<CourseKey> listed;
+                        for(auto it = r.completed.begin(); it != r.completed.end(); ++it) {
+                                if(countedBy[i].count(*it) != 0 && majorsCounting[*it] > 1 && listed.insert(*it).second) {
+                                        r.shared.push_back(*it);
+                                }
+                        }
+                }
+                return results;
+        };
+};
+
+#endif
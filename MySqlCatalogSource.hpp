@@ -0,0 +1,483 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      MySqlCatalogSource.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Reads the course catalog from the course_guide_system
+//                 database through its stored procedures, with connections
+//                 borrowed from a ConnectionPool.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MySqlCatalogSource_hpp
+#define MySqlCatalogSource_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "CourseCatalog.hpp"
+#include "MajorRequirements.hpp"
+#include "CourseDatabase.hpp"
+#include "ConnectionPool.hpp"
+#include "CatalogSource.hpp"
+
+// include mysql/c++ connector headers
+#include <cppconn/exception.h>
+#include <cppconn/resultset.h>
+#include <cppconn/prepared_statement.h>
+
+/* Every call borrows a connection for as long as it runs, so the source can be shared by
+ * any number of threads (they wait for a connection once the pool is full).
+ * loadRequirements is overridden to use a single connection and to fetch the choices of
+ * every option category in one pipelined batch. Course data goes through the process wide
+ * CourseCatalog so each course is only fetched once.
+ * Throws std::runtime_error if no connection can be made and sql::SQLException if a call
+ * fails (the connection it was made on is closed).
+ */
+class MySqlCatalogSource : public CatalogSource {
+
+public:
+        // max number of getCourseData calls sent to the server in a single round trip
+        static constexpr size_t COURSE_BATCH_SIZE = 64;
+
+private:
+        std::unique_ptr<ConnectionPool> pool;
+        std::atomic<bool> hasPrerequisites;// false once getPrerequisites is found missing
+
+        // the error of a CALL to a procedure the database does not have (ER_SP_DOES_NOT_EXIST)
+        static bool isMissingProcedure(const sql::SQLException &e) {
+                return e.getErrorCode() == 1305;
+        };
+
+        // calls f(CourseDatabase &) on a borrowed connection and returns what it returns
+        template<typename Function>
+        auto withConnection(Function f) -> decltype(f(std::declval<CourseDatabase &>())) {
+                std::string error;
+                ConnectionPool::Lease db = pool->borrow(error);
+                if(!db) {
+                        throw std::runtime_error(error);
+                }
+                try {
+                        return f(*db);
+                }
+                catch(sql::SQLException &e) {
+                        db.discard();// the connection may be left mid batch
+                        throw;
+                }
+        };
+
+        /* Creates a vector of Courses from vectors of course numbers and listings
+         * concatinates the class listing and course num into a string of the form "CS302"
+         */
+        static std::vector<Course> createCourses(const std::vector<std::string> &listings,
+                                                 const std::vector<std::string> &nums) {
+                std::vector<Course> courses;
+                auto it_listing = listings.begin();
+                for(auto it_num = nums.begin(); it_num != nums.end(); ++it_num) {
+                        std::string concat = *it_listing;
+                        concat.append(*it_num);
+                        Course c(concat);
+                        if(c.isValid()) {
+                                courses.push_back(c);
+                        }
+                        ++it_listing;
+                }
+                return courses;
+        };
+
+        // reads the courses (course num, listing) of a getOptionalElectives or getElectives call
+        static void readCourses(sql::ResultSet &res, std::vector<std::string> &nums,
+                                std::vector<std::string> &listings) {
+                while(res.next()) {
+                        nums.push_back(res.getString(1));
+                        listings.push_back(res.getString(2));
+                }
+        };
+
+        static bool getMajorId(CourseDatabase &db, const std::string &major, int &id) {
+                bool found = false;
+                db.call("CALL get_major_id(?, @m_id)",
+                        [&major](sql::PreparedStatement &p_stmt) { p_stmt.setString(1, major); },
+                        [](sql::ResultSet &) {});
+                db.call("SELECT @m_id", [&id, &found](sql::ResultSet &res) {
+                        id = res.getInt(1);
+                        found = !res.wasNull();
+                });
+                return found;
+        };
+
+        static std::vector<Course> getRequiredCourses(CourseDatabase &db, int majorId) {
+                std::vector<std::string> results;// holds database results
+                // This statement will return the data from each column as 1 big list
+                // the first half of the result set will be the course nums and second half is the listing
+                db.call("CALL get_abs_req_courses(?)",
+                        [majorId](sql::PreparedStatement &p_stmt) { p_stmt.setInt(1, majorId); },
+                        [&results](sql::ResultSet &res) { results.push_back(res.getString(1)); });
+                std::vector<std::string> nums(results.begin(), results.begin() + results.size() / 2);
+                std::vector<std::string> listings(results.begin() + results.size() / 2, results.end());
+                return createCourses(listings, nums);
+        };
+
+        static std::map<std::string, int> getMajorOptions(CourseDatabase &db, int majorId) {
+                // option_class name and number of classes which need to be taken to fulfill the req
+                std::map<std::string, int> optionClasses;
+                db.call("CALL getMajorOptions(?)",
+                        [majorId](sql::PreparedStatement &p_stmt) { p_stmt.setInt(1, majorId); },
+                        [&optionClasses](sql::ResultSet &res) {
+                                optionClasses.insert(std::pair<std::string, int>(res.getString(1), res.getInt(2)));
+                        });
+                return optionClasses;
+        };
+
+        static std::string getListing(CourseDatabase &db, int majorId) {
+                std::string listing;
+                db.call("CALL getListing(?, @lst)",
+                        [majorId](sql::PreparedStatement &p_stmt) { p_stmt.setInt(1, majorId); },
+                        [](sql::ResultSet &) {});
+                db.call("SELECT @lst", [&listing](sql::ResultSet &res) {
+                        listing = res.getString(1);
+                });
+                return listing;
+        };
+
+        /*
+         * Takes in a list of course objects with only the courseNum field non-null
+         * Communicates with the database to get the number of credits and full name
+         * and adds this info to the course list.
+         * The getCourseData calls are sent as multi statement batches of up to COURSE_BATCH_SIZE
+         * calls so the whole list costs a few round trips instead of one per course.
+         * Courses which appear more than once in the list are only looked up once and courses
+         * already held by the CourseCatalog are not looked up at all.
+         */
+        static void populateCourseData(CourseDatabase &db, std::vector<Course> &courses) {
+                CourseCatalog &catalog = CourseCatalog::instance();
+                // group the positions of each distinct course id so duplicates share a lookup
+                std::vector<CourseKey> ids;
+                std::unordered_map<CourseKey, std::vector<size_t> > positions;
+                for(size_t i = 0; i < courses.size(); ++i) {
+                        CourseKey key = courses[i].getKey();
+                        if(!key.isValid()) {
+                                continue;// not a valid course id - nothing to look up
+                        }
+                        std::vector<size_t> &pos = positions[key];
+                        if(pos.empty() && catalog.lookup(courses[i])) {
+                                continue;// served from the cache
+                        }
+                        if(pos.empty()) {
+                                ids.push_back(key);
+                        }
+                        pos.push_back(i);
+                }
+
+                for(size_t begin = 0; begin < ids.size(); begin += COURSE_BATCH_SIZE) {
+                        size_t end = std::min(ids.size(), begin + COURSE_BATCH_SIZE);
+                        // create one string holding every execute statement of this batch
+                        std::string exe;
+                        for(size_t i = begin; i < end; ++i) {
+                                exe.append("CALL getCourseData(");
+                                exe.append(std::to_string(ids[i].getNumber()));
+                                exe.append(", ");
+                                exe.append(CourseDatabase::quote(ids[i].getListing()));
+                                exe.append(");");
+                        }
+
+                        db.callBatch("CALL getCourseData(...) batch", exe, end - begin,
+                                     [&](size_t index, sql::ResultSet &res) {
+                                // get the course name and credits
+                                while(res.next()) {
+                                        std::string name = res.getString(1);
+                                        int credits = res.getInt(2);
+                                        std::vector<size_t> &pos = positions[ids[begin + index]];
+                                        for(auto it = pos.begin(); it != pos.end(); ++it) {
+                                                courses[*it].setName(name);
+                                                courses[*it].setCredits(credits);
+                                        }
+                                }
+                        });
+                }
+
+                // remember the fetched data (courses the database does not know are cached too)
+                for(auto it = ids.begin(); it != ids.end(); ++it) {
+                        catalog.insert(courses[positions[*it].front()]);
+                }
+        };
+
+public:
+        explicit MySqlCatalogSource(std::unique_ptr<ConnectionPool> pool) {
+                this->pool = std::move(pool);
+                this->hasPrerequisites = true;
+        };
+
+        /*
+         * Creates the source with a pool of connections to the database described by the
+         * database config (see DatabaseConfig): configFile if one was given, otherwise the file
+         * named by COURSE_GUIDE_DB_CONFIG, with COURSE_GUIDE_DB_* environment variables on top.
+         * A pool size of 0 in the config means one connection per worker.
+         * Returns an empty pointer and describes the problem in error if the config is not valid.
+         */
+        static std::unique_ptr<MySqlCatalogSource> create(const std::string &configFile, unsigned int workers,
+                                                          std::string &error) {
+                DatabaseConfig config;
+                if(!DatabaseConfig::load(configFile, config, error)) {
+                        return std::unique_ptr<MySqlCatalogSource>();
+                }
+                if(config.poolSize == 0) {
+                        config.poolSize = workers;
+                }
+                std::unique_ptr<ConnectionPool> pool(new ConnectionPool(config));
+                return std::unique_ptr<MySqlCatalogSource>(new MySqlCatalogSource(std::move(pool)));
+        };
+
+        /*
+         * Opens a connection to make sure the database can be reached.
+         * Returns false and describes the problem in error if it can not.
+         */
+        bool check(std::string &error) {
+                ConnectionPool::Lease db = pool->borrow(error);
+                return (bool)db;
+        };
+
+        bool getMajorId(const std::string &major, int &id) override {
+                return withConnection([&](CourseDatabase &db) { return getMajorId(db, major, id); });
+        };
+
+        std::vector<Course> getRequiredCourses(int majorId) override {
+                return withConnection([&](CourseDatabase &db) { return getRequiredCourses(db, majorId); });
+        };
+
+        std::map<std::string, int> getMajorOptions(int majorId) override {
+                return withConnection([&](CourseDatabase &db) { return getMajorOptions(db, majorId); });
+        };
+
+        std::vector<Course> getOptionalElectives(const std::string &category, int majorId) override {
+                return withConnection([&](CourseDatabase &db) {
+                        std::vector<std::string> nums, listings;
+                        db.call("CALL getOptionalElectives(?, ?)",
+                                [&](sql::PreparedStatement &p_stmt) {
+                                        p_stmt.setString(1, category);
+                                        p_stmt.setInt(2, majorId);
+                                },
+                                [&](sql::ResultSet &res) {
+                                        nums.push_back(res.getString(1));
+                                        listings.push_back(res.getString(2));
+                                });
+                        return createCourses(listings, nums);
+                });
+        };
+
+        std::string getListing(int majorId) override {
+                return withConnection([&](CourseDatabase &db) { return getListing(db, majorId); });
+        };
+
+        std::vector<Course> getElectives(const std::string &listing) override {
+                return withConnection([&](CourseDatabase &db) {
+                        std::vector<std::string> nums, listings;
+                        db.call("CALL getElectives(?)",
+                                [&](sql::PreparedStatement &p_stmt) { p_stmt.setString(1, listing); },
+                                [&](sql::ResultSet &res) {
+                                        nums.push_back(res.getString(1));
+                                        listings.push_back(res.getString(2));
+                                });
+                        return createCourses(listings, nums);
+                });
+        };
+
+        void getCourseData(std::vector<Course> &courses) override {
+                withConnection([&](CourseDatabase &db) { populateCourseData(db, courses); });
+        };
+
+        /*
+         * Asks the database for the prerequisites of a course.
+         * Returns none if the database does not provide prerequisites (the first call to find
+         * the procedure missing is remembered so later ones are not sent). Any other failure
+         * is thrown like every other call.
+         */
+        std::vector<Course> getPrerequisites(const Course &course) override {
+                if(!hasPrerequisites.load() || !course.isValid()) {
+                        return std::vector<Course>();
+                }
+                try {
+                        return withConnection([&](CourseDatabase &db) {
+                                std::vector<std::string> nums, listings;
+                                db.call("CALL getPrerequisites(?, ?)",
+                                        [&course](sql::PreparedStatement &p_stmt) {
+                                                p_stmt.setInt(1, course.getKey().getNumber());
+                                                p_stmt.setString(2, course.getKey().getListing());
+                                        },
+                                        [&](sql::ResultSet &res) {
+                                                nums.push_back(res.getString(1));
+                                                listings.push_back(res.getString(2));
+                                        });
+                                return createCourses(listings, nums);
+                        });
+                }
+                catch(sql::SQLException &e) {
+                        if(!isMissingProcedure(e)) {
+                                throw;
+                        }
+                        hasPrerequisites.store(false);
+                        return std::vector<Course>();
+                }
+        };
+
+        /*
+         * Asks the database for the prerequisites of every course in the list on one
+         * connection, sending the getPrerequisites calls as multi statement batches of up to
+         * COURSE_BATCH_SIZE calls like getCourseData.
+         * Missing prerequisites are handled like getPrerequisites.
+         */
+        std::vector<std::vector<Course> > getPrerequisiteLists(const std::vector<Course> &courses) override {
+                std::vector<std::vector<Course> > lists(courses.size());
+                std::vector<size_t> valid;// positions of the courses to look up
+                for(size_t i = 0; i < courses.size(); ++i) {
+                        if(courses[i].isValid()) {
+                                valid.push_back(i);
+                        }
+                }
+                if(!hasPrerequisites.load() || valid.empty()) {
+                        return lists;
+                }
+                try {
+                        withConnection([&](CourseDatabase &db) {
+                                for(size_t begin = 0; begin < valid.size(); begin += COURSE_BATCH_SIZE) {
+                                        size_t end = std::min(valid.size(), begin + COURSE_BATCH_SIZE);
+                                        std::string exe;
+                                        for(size_t i = begin; i < end; ++i) {
+                                                CourseKey key = courses[valid[i]].getKey();
+                                                exe.append("CALL getPrerequisites(");
+                                                exe.append(std::to_string(key.getNumber()));
+                                                exe.append(", ");
+                                                exe.append(CourseDatabase::quote(key.getListing()));
+                                                exe.append(");");
+                                        }
+                                        db.callBatch("CALL getPrerequisites(...) batch", exe, end - begin,
+                                                     [&](size_t index, sql::ResultSet &res) {
+                                                std::vector<std::string> nums, listings;
+                                                readCourses(res, nums, listings);
+                                                lists[valid[begin + index]] = createCourses(listings, nums);
+                                        });
+                                }
+                        });
+                }
+                catch(sql::SQLException &e) {
+                        if(!isMissingProcedure(e)) {
+                                throw;
+                        }
+                        hasPrerequisites.store(false);
+                        return std::vector<std::vector<Course> >(courses.size());
+                }
+                return lists;
+        };
+
+        // true until getPrerequisites finds the database does not provide them
+        bool providesPrerequisites() override {
+                return hasPrerequisites.load();
+        };
+
+        /*
+         * Asks the database for the current version of the course catalog.
+         * Returns an empty string if the database does not provide a catalog version.
+         */
+        std::string getCatalogVersion() override {
+                return withConnection([](CourseDatabase &db) {
+                        std::string version;
+                        try {
+                                db.call("CALL getCatalogVersion(@ver)", [](sql::ResultSet &) {});
+                                db.call("SELECT @ver", [&version](sql::ResultSet &res) {
+                                        version = res.getString(1);
+                                });
+                        }
+                        catch(sql::SQLException &e) {
+                                // no version available - the cache is never invalidated automatically
+                                version.clear();
+                        }
+                        return version;
+                });
+        };
+
+        /*
+         * Loads the requirements of a major on one connection.
+         * The choices of all the option categories are fetched in a single pipelined batch and
+         * their course data in shared getCourseData batches, so the number of round trips does
+         * not grow with the number of categories.
+         */
+        bool loadRequirements(const std::string &major, MajorRequirements &req) override {
+                return withConnection([&](CourseDatabase &db) {
+                        req = MajorRequirements();
+                        if(!getMajorId(db, major, req.id)) {
+                                return false;
+                        }
+                        req.major = major;
+                        req.required = getRequiredCourses(db, req.id);
+                        std::vector<OptionCategory> categories = orderCategories(getMajorOptions(db, req.id));
+                        bool hasElectives = !categories.empty() && categories.back().name == "Electives";
+                        if(hasElectives) {
+                                // any class above 400 counts as an elective
+                                req.listing = getListing(db, req.id);
+                        }
+
+                        // get the choices of every category in one round trip instead of one per category
+                        // every CALL of the batch produces one result set, in the order of categories
+                        std::string exe;
+                        for(auto it = categories.begin(); it != categories.end(); ++it) {
+                                if(hasElectives && it + 1 == categories.end()) {
+                                        // call getElectives on this major listing
+                                        exe.append("CALL getElectives(");
+                                        exe.append(CourseDatabase::quote(req.listing));
+                                        exe.append(");");
+                                        break;
+                                }
+                                exe.append("CALL getOptionalElectives(");
+                                exe.append(CourseDatabase::quote(it->name));
+                                exe.append(", ");
+                                exe.append(std::to_string(req.id));
+                                exe.append(");");
+                        }
+                        std::vector< std::vector<std::string> > o_courseNums(categories.size());
+                        std::vector< std::vector<std::string> > o_listings(categories.size());
+                        if(!categories.empty()) {
+                                db.callBatch("CALL getOptionalElectives/getElectives(...) batch", exe, categories.size(),
+                                             [&o_courseNums, &o_listings](size_t index, sql::ResultSet &res) {
+                                        readCourses(res, o_courseNums[index], o_listings[index]);
+                                });
+                        }
+
+                        // populate every course of the requirements at once so all the categories
+                        // share the batches
+                        // (a pooled Electives category is left out - its data is read when shown)
+                        std::vector<Course> all(req.required);
+                        for(size_t i = 0; i < categories.size(); ++i) {
+                                categories[i].courses = createCourses(o_listings[i], o_courseNums[i]);
+                                categories[i].pooled = isPooled(categories[i]);
+                                if(!categories[i].pooled) {
+                                        all.insert(all.end(), categories[i].courses.begin(), categories[i].courses.end());
+                                }
+                        }
+                        populateCourseData(db, all);
+                        auto from = all.begin();
+                        req.required.assign(from, from + req.required.size());
+                        from += req.required.size();
+                        for(auto it = categories.begin(); it != categories.end(); ++it) {
+                                if(!it->pooled) {
+                                        it->courses.assign(from, from + it->courses.size());
+                                        from += it->courses.size();
+                                }
+                        }
+                        req.categories = categories;
+                        return true;
+                });
+        };
+
+        void printStats(std::ostream &out) override {
+                pool->printStats(out);
+        };
+};
+
+#endif
@@ -0,0 +1,363 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      Prerequisites.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    The prerequisites of the courses a major uses: the graph
+//                 read from the catalog, a bitset index over it that answers
+//                 "what can I take next semester?" without walking chains,
+//                 and a cache holding both for every major.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef Prerequisites_hpp
+#define Prerequisites_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "MajorRequirements.hpp"
+#include "AuditResult.hpp"
+#include "CatalogSource.hpp"
+#include "Metrics.hpp"
+
+/* The prerequisites of every course a plan for a major could use: its required courses,
+ * the choices of its categories and, in turn, their prerequisites. Holds the data of all
+ * of those courses too. Built once per major and only read afterwards.
+ */
+struct PrerequisiteGraph {
+        std::unordered_map<CourseKey, std::vector<CourseKey> > prerequisites;// only courses that have some
+        std::unordered_map<CourseKey, Course> courses;
+
+        // the prerequisites of a course (NULL if it has none)
+        const std::vector<CourseKey> *find(CourseKey key) const {
+                auto it = prerequisites.find(key);
+                return (it == prerequisites.end()) ? NULL : &it->second;
+        };
+
+        /*
+         * Reads the prerequisites of the courses in a major's requirements from a source, a
+         * level of the chains at a time so each level is one getPrerequisiteLists call.
+         * Exceptions from the source are passed on.
+         */
+        static std::shared_ptr<const PrerequisiteGraph> load(CatalogSource &source, const MajorRequirements &req) {
+                std::shared_ptr<PrerequisiteGraph> graph(new PrerequisiteGraph());
+                std::vector<Course> pending, found;// found: prerequisites outside the requirements
+                std::unordered_set<CourseKey> seen;
+                auto visit = [&](const Course &c) {
+                        if(c.isValid() && seen.insert(c.getKey()).second) {
+                                pending.push_back(c);
+                                graph->courses[c.getKey()] = c;
+                        }
+                };
+                std::for_each(req.required.begin(), req.required.end(), visit);
+                for(auto it = req.categories.begin(); it != req.categories.end(); ++it) {
+                        std::for_each(it->courses.begin(), it->courses.end(), visit);
+                }
+                while(!pending.empty()) {
+                        std::vector<Course> level;
+                        level.swap(pending);
+                        std::vector<std::vector<Course> > lists = source.getPrerequisiteLists(level);
+                        for(size_t i = 0; i < level.size() && i < lists.size(); ++i) {
+                                CourseKey key = level[i].getKey();
+                                for(auto it = lists[i].begin(); it != lists[i].end(); ++it) {
+                                        if(!it->isValid() || it->getKey() == key) {
+                                                continue;
+                                        }
+                                        graph->prerequisites[key].push_back(it->getKey());
+                                        if(seen.insert(it->getKey()).second) {
+                                                pending.push_back(*it);
+                                                found.push_back(*it);
+                                        }
+                                }
+                        }
+                }
+                source.getCourseData(found);
+                for(auto it = found.begin(); it != found.end(); ++it) {
+                        graph->courses[it->getKey()] = *it;
+                }
+                return graph;
+        };
+};
+
+/* A PrerequisiteGraph turned into bitsets. Every course of the graph gets a dense id and
+ * a row of bits (one per course): its direct prerequisites and its closure (every course
+ * on a prerequisite chain leading to it). The courses each requirement of the major
+ * counts toward are rows too. A question about a student then comes down to ANDing rows
+ * with the bitset of their completed courses, a word at a time.
+ * A course can be taken once its direct prerequisites are passed - the closure is not
+ * required, so a student let into a course without one of its own prerequisites still
+ * qualifies for the courses after it.
+ * Only read once built, so it can be shared between threads.
+ */
+class PrerequisiteIndex {
+
+public:
+        typedef std::vector<uint64_t> Bitset;
+
+private:
+        size_t words;// per row
+        std::vector<Course> courses;// by id
+        std::unordered_map<CourseKey, uint32_t> ids;
+        std::vector<uint64_t> direct, closure;// one row per course
+        Bitset required;
+        std::vector<uint64_t> categories;// one row per category of the major, in audit order
+
+        uint64_t *row(std::vector<uint64_t> &rows, size_t id) {
+                return rows.data() + id * words;
+        };
+
+        const uint64_t *row(const std::vector<uint64_t> &rows, size_t id) const {
+                return rows.data() + id * words;
+        };
+
+        static void set(uint64_t *bits, size_t id) {
+                bits[id / 64] |= (uint64_t)1 << (id % 64);
+        };
+
+        static bool test(const uint64_t *bits, size_t id) {
+                return (bits[id / 64] >> (id % 64)) & 1;
+        };
+
+        uint32_t intern(const Course &c) {
+                auto found = ids.find(c.getKey());
+                if(found != ids.end()) {
+                        return found->second;
+                }
+                uint32_t id = (uint32_t)courses.size();
+                ids.insert(std::make_pair(c.getKey(), id));
+                courses.push_back(c);
+                return id;
+        };
+
+        // fills in the closure of a course (state: 0 new, 1 being filled, 2 done)
+        void close(size_t id, std::vector<char> &state) {
+                state[id] = 1;
+                uint64_t *mine = row(closure, id);
+                for(size_t p = 0; p < courses.size(); ++p) {
+                        if(!test(row(direct, id), p)) {
+                                continue;
+                        }
+                        if(state[p] == 0) {
+                                close(p, state);
+                        }
+                        // a prerequisite on a cycle back to this course adds what it has so far
+                        const uint64_t *theirs = row(closure, p);
+                        for(size_t w = 0; w < words; ++w) {
+                                mine[w] |= theirs[w];
+                        }
+                        set(mine, p);
+                }
+                state[id] = 2;
+        };
+
+public:
+        PrerequisiteIndex(const MajorRequirements &req, const PrerequisiteGraph &graph) {
+                // the major's courses first, so their data comes from the requirements
+                for(auto it = req.required.begin(); it != req.required.end(); ++it) {
+                        intern(*it);
+                }
+                for(auto c = req.categories.begin(); c != req.categories.end(); ++c) {
+                        for(auto it = c->courses.begin(); it != c->courses.end(); ++it) {
+                                intern(*it);
+                        }
+                }
+                for(auto it = graph.courses.begin(); it != graph.courses.end(); ++it) {
+                        intern(it->second);
+                }
+                for(auto it = graph.prerequisites.begin(); it != graph.prerequisites.end(); ++it) {
+                        for(auto p = it->second.begin(); p != it->second.end(); ++p) {
+                                intern(Course(*p));
+                        }
+                }
+
+                this->words = (courses.size() + 63) / 64;
+                direct.assign(courses.size() * words, 0);
+                closure.assign(courses.size() * words, 0);
+                for(auto it = graph.prerequisites.begin(); it != graph.prerequisites.end(); ++it) {
+                        auto course = ids.find(it->first);
+                        for(auto p = it->second.begin(); course != ids.end() && p != it->second.end(); ++p) {
+                                set(row(direct, course->second), ids[*p]);
+                        }
+                }
+                std::vector<char> state(courses.size(), 0);
+                for(size_t id = 0; id < courses.size(); ++id) {
+                        if(state[id] == 0) {
+                                close(id, state);
+                        }
+                }
+
+                required.assign(words, 0);
+                for(auto it = req.required.begin(); it != req.required.end(); ++it) {
+                        set(required.data(), ids[it->getKey()]);
+                }
+                categories.assign(req.categories.size() * words, 0);
+                for(size_t c = 0; c < req.categories.size(); ++c) {
+                        const std::vector<Course> &choices = req.categories[c].courses;
+                        for(auto it = choices.begin(); it != choices.end(); ++it) {
+                                set(row(categories, c), ids[it->getKey()]);
+                        }
+                }
+        };
+
+        size_t size() const {
+                return courses.size();
+        };
+
+        // the set of the listed courses the index knows
+        Bitset toSet(const std::vector<CourseKey> &keys) const {
+                Bitset bits(words, 0);
+                for(auto it = keys.begin(); it != keys.end(); ++it) {
+                        auto found = ids.find(*it);
+                        if(found != ids.end()) {
+                                set(bits.data(), found->second);
+                        }
+                }
+                return bits;
+        };
+
+        // true if every direct prerequisite of a course is in completed
+        bool isEligible(CourseKey course, const Bitset &completed) const {
+                auto found = ids.find(course);
+                if(found == ids.end()) {
+                        return true;// not in the catalog's graph - no known prerequisites
+                }
+                const uint64_t *needs = row(direct, found->second);
+                for(size_t w = 0; w < words; ++w) {
+                        if(needs[w] & ~completed[w]) {
+                                return false;
+                        }
+                }
+                return true;
+        };
+
+        /*
+         * Every course on a prerequisite chain leading to course that is not in completed -
+         * what a student still has to pass before they could take it (in id order).
+         */
+        std::vector<Course> getMissing(CourseKey course, const Bitset &completed) const {
+                std::vector<Course> missing;
+                auto found = ids.find(course);
+                if(found == ids.end()) {
+                        return missing;
+                }
+                const uint64_t *needs = row(closure, found->second);
+                for(size_t w = 0; w < words; ++w) {
+                        for(uint64_t left = needs[w] & ~completed[w]; left != 0; left &= left - 1) {
+                                size_t id = w * 64 + __builtin_ctzll(left);
+                                if(id != found->second) {
+                                        missing.push_back(courses[id]);
+                                }
+                        }
+                }
+                return missing;
+        };
+
+        /*
+         * The courses an audited student can take next semester: every course not yet passed
+         * that counts toward a requirement they have not met (a remaining required course or
+         * a choice of an open category) and whose prerequisites they have all passed.
+         * The result must come from the requirements the index was built for. Sorted by id.
+         */
+        std::vector<Course> eligibleCourses(const AuditResult &result) const {
+                static Histogram &eligibleTime = Metrics::stage("eligible");
+                ScopedTimer timer(eligibleTime);
+                Bitset completed = toSet(result.completed);
+                Bitset wanted(required);
+                for(size_t c = 0; c < result.getCategories().size() && c * words < categories.size(); ++c) {
+                        if(!result.getCategories()[c].isComplete()) {
+                                const uint64_t *choices = row(categories, c);
+                                for(size_t w = 0; w < words; ++w) {
+                                        wanted[w] |= choices[w];
+                                }
+                        }
+                }
+                std::vector<Course> eligible;
+                for(size_t w = 0; w < words; ++w) {
+                        for(uint64_t left = wanted[w] & ~completed[w]; left != 0; left &= left - 1) {
+                                size_t id = w * 64 + __builtin_ctzll(left);
+                                const uint64_t *needs = row(direct, id);
+                                size_t v = 0;
+                                while(v < words && (needs[v] & ~completed[v]) == 0) {
+                                        ++v;
+                                }
+                                if(v == words) {
+                                        eligible.push_back(courses[id]);
+                                }
+                        }
+                }
+                std::sort(eligible.begin(), eligible.end());
+                return eligible;
+        };
+};
+
+/* The prerequisite graphs and indexes of the majors used so far. They are built again
+ * when the requirements they were built for are replaced (the RequirementsCache reloads a
+ * major when the catalog changes), so they never outlive the catalog they were read from.
+ * Safe to share between threads.
+ */
+class PrerequisiteCache {
+
+private:
+        struct Entry {
+                std::shared_ptr<const MajorRequirements> req;
+                std::shared_ptr<const PrerequisiteGraph> graph;
+                std::shared_ptr<const PrerequisiteIndex> index;
+        };
+
+        std::unordered_map<std::string, Entry> entries;// by major
+        mutable std::mutex lock;
+
+        // the entry of a major, loading it from the source on a miss (the lock is not held while loading)
+        Entry find(CatalogSource &source, std::shared_ptr<const MajorRequirements> req) {
+                {
+                        std::lock_guard<std::mutex> guard(lock);
+                        auto it = entries.find(req->major);
+                        if(it != entries.end() && it->second.req == req) {
+                                return it->second;
+                        }
+                }
+                Entry loaded;
+                loaded.req = req;
+                loaded.graph = PrerequisiteGraph::load(source, *req);
+                loaded.index.reset(new PrerequisiteIndex(*req, *loaded.graph));
+                std::lock_guard<std::mutex> guard(lock);
+                entries[req->major] = loaded;
+                return loaded;
+        };
+
+public:
+        PrerequisiteCache() {
+        };
+
+        PrerequisiteCache(const PrerequisiteCache &) = delete;
+        PrerequisiteCache &operator=(const PrerequisiteCache &) = delete;
+
+        /*
+         * Gets the graph for a major's requirements. Exceptions from the source are passed on.
+         */
+        std::shared_ptr<const PrerequisiteGraph> get(CatalogSource &source,
+                                                     std::shared_ptr<const MajorRequirements> req) {
+                return find(source, req).graph;
+        };
+
+        // the same for the index
+        std::shared_ptr<const PrerequisiteIndex> getIndex(CatalogSource &source,
+                                                          std::shared_ptr<const MajorRequirements> req) {
+                return find(source, req).index;
+        };
+
+        size_t size() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return entries.size();
+        };
+};
+
+#endif
@@ -0,0 +1,461 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      ReportWriter.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Renders AuditResults as the usual text report, as JSON
+//                 (one object per line) or as CSV (one row per requirement).
+//                 Output is collected in a buffer and written to the stream
+//                 in large blocks instead of flushing every line.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ReportWriter_hpp
+#define ReportWriter_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include "AuditResult.hpp"
+#include "Metrics.hpp"
+
+enum ReportFormat {
+        REPORT_TEXT,
+        REPORT_JSON,
+        REPORT_CSV
+};
+
+class ReportWriter {
+
+private:
+        static const size_t FLUSH_SIZE = 64 * 1024;
+
+        std::ostream &out;
+        ReportFormat format;
+        std::string buffer;
+        size_t written;// number of results written so far
+
+        void put(const std::string &s) {
+                buffer.append(s);
+        };
+
+        void put(int n) {
+                buffer.append(std::to_string(n));
+        };
+
+        // writes the buffer to the stream once it is large enough
+        void spill() {
+                if(buffer.size() >= FLUSH_SIZE) {
+                        out.write(buffer.data(), buffer.size());
+                        buffer.clear();
+                }
+        };
+
+        void putJsonString(const std::string &s) {
+                appendJsonString(buffer, s);
+        };
+
+        void putJsonKeys(const std::vector<CourseKey> &keys) {
+                buffer.push_back('[');
+                for(auto it = keys.begin(); it != keys.end(); ++it) {
+                        if(it != keys.begin()) {
+                                buffer.push_back(',');
+                        }
+                        putJsonString((*it).toString());
+                }
+                buffer.push_back(']');
+        };
+
+        void putJsonCourses(const std::vector<Course> &courses) {
+                buffer.push_back('[');
+                for(auto it = courses.begin(); it != courses.end(); ++it) {
+                        if(it != courses.begin()) {
+                                buffer.push_back(',');
+                        }
+                        put("{\"course\":");
+                        putJsonString((*it).getCourseNum());
+                        put(",\"name\":");
+                        putJsonString((*it).getName());
+                        put(",\"credits\":");
+                        put((*it).getCredits());
+                        buffer.push_back('}');
+                }
+                buffer.push_back(']');
+        };
+
+        // joins the course ids of a list with ';'
+        template<typename List>
+        static std::string idList(const List &list) {
+                std::string joined;
+                for(auto it = list.begin(); it != list.end(); ++it) {
+                        if(it != list.begin()) {
+                                joined.push_back(';');
+                        }
+                        joined.append(courseId(*it));
+                }
+                return joined;
+        };
+
+        static std::string courseId(const Course &c) {
+                return c.getCourseNum();
+        };
+
+        static std::string courseId(const CourseKey &k) {
+                return k.toString();
+        };
+
+        void putCsvRow(const AuditResult &r, const std::string &requirement, int needed, int outstanding,
+                       int credits, const std::string &used, const std::string &choices) {
+                put(csvField(r.id) + "," + csvField(r.major) + "," + csvField(requirement) + ",");
+                put(needed);
+                buffer.push_back(',');
+                put(outstanding);
+                buffer.push_back(',');
+                putCredits(credits, "");
+                put("," + csvField(used) + "," + csvField(choices) + "\n");
+        };
+
+        // writes a number of credits, or unknown if they are not known
+        void putCredits(int credits, const std::string &unknown) {
+                if(credits == CategoryResult::CREDITS_UNKNOWN) {
+                        put(unknown);
+                } else {
+                        put(credits);
+                }
+        };
+
+        void putCourse(const Course &c) {
+                put(c.getName());
+                put(" - ");
+                put(c.getCourseNum());
+                put("\n   Credits = ");
+                put(c.getCredits());
+                buffer.push_back('\n');
+        };
+
+        static int credits(const std::vector<Course> &courses) {
+                int total = 0;
+                for(auto it = courses.begin(); it != courses.end(); ++it) {
+                        total += (*it).getCredits();
+                }
+                return total;
+        };
+
+        void writePlanText(const GraduationPlan &plan) {
+                put("\nGraduation plan (at most ");
+                put(plan.creditCap);
+                put(" credits a semester):\n");
+                if(!plan.isFeasible()) {
+                        put(" No plan could be made: " + plan.problem + ".\n");
+                        return;
+                }
+                if(plan.semesters.empty()) {
+                        put(" Nothing is left to take.\n");
+                }
+                for(size_t i = 0; i < plan.semesters.size(); ++i) {
+                        put(" Semester ");
+                        put((int)i + 1);
+                        put(" (");
+                        put(credits(plan.semesters[i]));
+                        put(" credits): " + idList(plan.semesters[i]) + "\n");
+                }
+        };
+
+        void writeText(const AuditResult &r) {
+                if(written > 0) {
+                        buffer.push_back('\n');// blank line between students
+                }
+                if(!r.majorFound) {
+                        put("The major " + r.major + " could not be found.\n");
+                        return;
+                }
+                put("Name: " + r.name + "\nYear: ");
+                put(r.year);
+                put("\nMajor: " + r.major + "\nID: " + r.id + "\nCompleted Classes: \n");
+                for(auto it = r.completed.begin(); it != r.completed.end(); ++it) {
+                        put(" " + (*it).toString() + "\n");
+                }
+                put("\nRequired Courses for " + r.major + ":\n");
+                for(auto it = r.requiredRemaining.begin(); it != r.requiredRemaining.end(); ++it) {
+                        buffer.push_back('-');
+                        putCourse(*it);
+                }
+                buffer.push_back('\n');
+
+                for(auto c = r.getCategories().begin(); c != r.getCategories().end(); ++c) {
+                        put(c->name + ":\n");
+                        for(auto it = c->used.begin(); it != c->used.end(); ++it) {
+                                put(" " + (*it).toString() + " can be used to fulfill this requirement.\n");
+                        }
+                        if(c->isComplete()) {
+                                put(" You've completed the " + c->name + " requirement.\n");
+                        } else {
+                                put(" You must take ");
+                                put(c->outstanding);
+                                put(c->outstanding > 1 ? " more classes " : " more class ");
+                                put("from the " + c->name + " category.\n A list of your choices:\n");
+                                for(auto it = c->choices.begin(); it != c->choices.end(); ++it) {
+                                        put(" -");
+                                        putCourse(*it);
+                                }
+                                if(c->moreChoices > 0) {
+                                        put(" ... and ");
+                                        put((int)c->moreChoices);
+                                        put(" more.\n");
+                                }
+                        }
+                        // a blank line follows every category but a trailing Electives category
+                        if(c + 1 != r.getCategories().end() || c->name != "Electives") {
+                                buffer.push_back('\n');
+                        }
+                }
+                if(!r.otherMajors.empty()) {
+                        put("\nAlso audited for:");
+                        for(auto it = r.otherMajors.begin(); it != r.otherMajors.end(); ++it) {
+                                put((it == r.otherMajors.begin() ? " " : ", ") + *it);
+                        }
+                        put(r.shared.empty() ? "\n No course counts for more than one major.\n"
+                                             : "\n Courses that count for another major too:\n");
+                        for(auto it = r.shared.begin(); it != r.shared.end(); ++it) {
+                                put(" " + (*it).toString() + "\n");
+                        }
+                }
+                if(r.eligibleListed) {
+                        put("\nCourses you can take next semester:\n");
+                        if(r.eligible.empty()) {
+                                put(" None - every course you still need has a prerequisite you have not passed.\n");
+                        }
+                        for(auto it = r.eligible.begin(); it != r.eligible.end(); ++it) {
+                                put(" -");
+                                putCourse(*it);
+                        }
+                }
+                if(r.plan.made) {
+                        writePlanText(r.plan);
+                }
+        };
+
+        void writeJson(const AuditResult &r) {
+                put("{\"id\":");
+                putJsonString(r.id);
+                put(",\"name\":");
+                putJsonString(r.name);
+                put(",\"year\":");
+                put(r.year);
+                put(",\"major\":");
+                putJsonString(r.major);
+                put(",\"major_found\":");
+                put(r.majorFound ? "true" : "false");
+                put(",\"complete\":");
+                put(r.isComplete() ? "true" : "false");
+                put(",\"credits_outstanding\":");
+                putCredits(r.creditsOutstanding(), "null");
+                put(",\"completed\":");
+                putJsonKeys(r.completed);
+                put(",\"required\":{\"completed\":");
+                putJsonCourses(r.requiredCompleted);
+                put(",\"remaining\":");
+                putJsonCourses(r.requiredRemaining);
+                put("},\"categories\":[");
+                for(auto c = r.getCategories().begin(); c != r.getCategories().end(); ++c) {
+                        if(c != r.getCategories().begin()) {
+                                buffer.push_back(',');
+                        }
+                        put("{\"name\":");
+                        putJsonString(c->name);
+                        put(",\"needed\":");
+                        put(c->numRequired);
+                        put(",\"outstanding\":");
+                        put(c->outstanding);
+                        put(",\"credits_outstanding\":");
+                        putCredits(c->creditsOutstanding, "null");
+                        put(",\"used\":");
+                        putJsonKeys(c->used);
+                        put(",\"choices\":");
+                        putJsonCourses(c->isComplete() ? std::vector<Course>() : c->choices);
+                        if(c->moreChoices > 0) {
+                                put(",\"more_choices\":");
+                                put((int)c->moreChoices);
+                        }
+                        buffer.push_back('}');
+                }
+                buffer.push_back(']');
+                if(!r.otherMajors.empty()) {
+                        put(",\"other_majors\":[");
+                        for(auto it = r.otherMajors.begin(); it != r.otherMajors.end(); ++it) {
+                                if(it != r.otherMajors.begin()) {
+                                        buffer.push_back(',');
+                                }
+                                putJsonString(*it);
+                        }
+                        put("],\"shared\":");
+                        putJsonKeys(r.shared);
+                }
+                if(r.eligibleListed) {
+                        put(",\"eligible\":");
+                        putJsonCourses(r.eligible);
+                }
+                if(r.plan.made) {
+                        put(",\"plan\":{\"feasible\":");
+                        put(r.plan.isFeasible() ? "true" : "false");
+                        put(",\"problem\":");
+                        putJsonString(r.plan.problem);
+                        put(",\"credit_cap\":");
+                        put(r.plan.creditCap);
+                        put(",\"lower_bound\":");
+                        put(r.plan.lowerBound);
+                        put(",\"optimal\":");
+                        put(r.plan.isOptimal() ? "true" : "false");
+                        put(",\"semesters\":[");
+                        for(auto it = r.plan.semesters.begin(); it != r.plan.semesters.end(); ++it) {
+                                if(it != r.plan.semesters.begin()) {
+                                        buffer.push_back(',');
+                                }
+                                put("{\"credits\":");
+                                put(credits(*it));
+                                put(",\"courses\":");
+                                putJsonCourses(*it);
+                                buffer.push_back('}');
+                        }
+                        put("]}");
+                }
+                put("}\n");
+        };
+
+        void writeCsv(const AuditResult &r) {
+                if(written == 0) {
+                        put("student_id,major,requirement,needed,outstanding,credits_outstanding,used,choices\n");
+                }
+                if(!r.majorFound) {
+                        putCsvRow(r, "", 0, 0, 0, "", "");
+                        return;
+                }
+                int requiredCredits = 0;
+                for(auto it = r.requiredRemaining.begin(); it != r.requiredRemaining.end(); ++it) {
+                        requiredCredits += (*it).getCredits();
+                }
+                putCsvRow(r, "Required Courses", r.requiredCompleted.size() + r.requiredRemaining.size(),
+                          r.requiredRemaining.size(), requiredCredits, idList(r.requiredCompleted),
+                          idList(r.requiredRemaining));
+                for(auto c = r.getCategories().begin(); c != r.getCategories().end(); ++c) {
+                        putCsvRow(r, c->name, c->numRequired, c->outstanding, c->creditsOutstanding, idList(c->used),
+                                  c->isComplete() ? std::string() : idList(c->choices));
+                }
+                if(!r.otherMajors.empty()) {
+                        putCsvRow(r, "Shared with other majors", 0, 0, 0, idList(r.shared), "");
+                }
+                if(r.eligibleListed) {
+                        putCsvRow(r, "Eligible next semester", r.eligible.size(), r.eligible.size(),
+                                  credits(r.eligible), "", idList(r.eligible));
+                }
+                // one row per planned semester, holding its courses as the choices
+                if(r.plan.made && !r.plan.isFeasible()) {
+                        putCsvRow(r, "Plan", 0, 0, 0, "", r.plan.problem);
+                }
+                for(size_t i = 0; r.plan.isFeasible() && i < r.plan.semesters.size(); ++i) {
+                        const std::vector<Course> &semester = r.plan.semesters[i];
+                        putCsvRow(r, "Semester " + std::to_string(i + 1), semester.size(), semester.size(),
+                                  credits(semester), "", idList(semester));
+                }
+        };
+
+public:
+        // appends s to a string as a quoted JSON string
+        static void appendJsonString(std::string &to, const std::string &s) {
+                to.push_back('"');
+                for(auto it = s.begin(); it != s.end(); ++it) {
+                        unsigned char c = *it;
+                        if(c == '"' || c == '\\') {
+                                to.push_back('\\');
+                                to.push_back(c);
+                        } else if(c < 0x20) {
+                                char escaped[8];
+                                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                                to.append(escaped);
+                        } else {
+                                to.push_back(c);
+                        }
+                }
+                to.push_back('"');
+        };
+
+        static std::string jsonString(const std::string &s) {
+                std::string quoted;
+                appendJsonString(quoted, s);
+                return quoted;
+        };
+
+        // quotes a CSV field if it needs it
+        static std::string csvField(const std::string &s) {
+                if(s.find_first_of(",\"\n") == std::string::npos) {
+                        return s;
+                }
+                std::string quoted("\"");
+                for(auto it = s.begin(); it != s.end(); ++it) {
+                        if(*it == '"') {
+                                quoted.push_back('"');
+                        }
+                        quoted.push_back(*it);
+                }
+                quoted.push_back('"');
+                return quoted;
+        };
+
+        ReportWriter(std::ostream &out, ReportFormat format) : out(out) {
+                this->format = format;
+                this->written = 0;
+        };
+
+        ~ReportWriter() {
+                flush();
+        };
+
+        ReportWriter(const ReportWriter &) = delete;
+        ReportWriter &operator=(const ReportWriter &) = delete;
+
+        // adds the report of one student
+        void write(const AuditResult &r) {
+                static Histogram &reportTime = Metrics::stage("report");
+                ScopedTimer timer(reportTime);
+                switch(format) {
+                        case REPORT_TEXT: writeText(r); break;
+                        case REPORT_JSON: writeJson(r); break;
+                        case REPORT_CSV: writeCsv(r); break;
+                }
+                ++written;
+                spill();
+        };
+
+        // writes everything buffered so far to the stream
+        void flush() {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+                out.flush();
+        };
+
+        // reads a format name ("text", "json" or "csv")
+        static bool parseFormat(const std::string &name, ReportFormat &format) {
+                if(name == "text") {
+                        format = REPORT_TEXT;
+                } else if(name == "json") {
+                        format = REPORT_JSON;
+                } else if(name == "csv") {
+                        format = REPORT_CSV;
+                } else {
+                        return false;
+                }
+                return true;
+        };
+
+        // file extension used for reports in a format
+        static std::string extension(ReportFormat format) {
+                switch(format) {
+                        case REPORT_JSON: return ".json";
+                        case REPORT_CSV: return ".csv";
+                        default: return ".audit";
+                }
+        };
+};
+
+#endif
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      RequirementMatcher.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Assigns a student's completed courses to the option
+//                 categories of their major. Every course counts toward at
+//                 most one category and as many requirements as possible
+//                 are filled, no matter what order the courses come in.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RequirementMatcher_hpp
+#define RequirementMatcher_hpp
+
+#include <vector>
+#include <utility>
+
+/* Solves the assignment as a maximum flow problem: each category can take numRequired
+ * courses and each completed course can be used once. Categories are filled in the
+ * order given (Electives last), and filling a later category only ever moves courses
+ * between earlier categories - it never leaves an earlier category with fewer courses.
+ * So the other requirements always get the first claim on a course, like before, but a
+ * course is no longer wasted on a category that could have used a different one.
+ */
+class RequirementMatcher {
+
+private:
+        std::vector<std::vector<int> > edges;// per category: completed courses it accepts
+        std::vector<int> capacity, load;// per category
+        std::vector<int> owner;// per completed course: category using it (-1 if unused)
+        std::vector<unsigned int> visited;// per category: stamp of the last search
+        unsigned int stamp;
+
+        // tries to give category one more course, moving courses between categories if needed
+        bool augment(int category) {
+                visited[category] = stamp;
+                const std::vector<int> &accepts = edges[category];
+                for(auto it = accepts.begin(); it != accepts.end(); ++it) {
+                        if(owner[*it] == -1) {
+                                owner[*it] = category;
+                                return true;
+                        }
+                }
+                // every course this category accepts is taken - see if a holder can switch
+                for(auto it = accepts.begin(); it != accepts.end(); ++it) {
+                        int other = owner[*it];
+                        if(other == category || visited[other] == stamp) {
+                                continue;
+                        }
+                        if(augment(other)) {
+                                owner[*it] = category;
+                                return true;
+                        }
+                }
+                return false;
+        };
+
+        // fills the categories in order (edges, capacity and owner are set up)
+        void fill() {
+                size_t n = edges.size();
+                load.assign(n, 0);
+                visited.assign(n, 0);
+                stamp = 0;
+                for(size_t c = 0; c < n; ++c) {
+                        while(load[c] < capacity[c]) {
+                                ++stamp;
+                                if(!augment(c)) {
+                                        break;
+                                }
+                                ++load[c];
+                        }
+                }
+        };
+
+public:
+        RequirementMatcher() {
+                this->stamp = 0;
+        };
+
+        /*
+         * Assigns the completed courses, numbered 0 to numCourses - 1 (see RequirementProgram),
+         * to the categories. accepts holds, for each category, the completed courses it takes in
+         * the order of its choices and without duplicates. Returns the category each course was
+         * given to (-1 if none).
+         */
+        std::vector<int> match(std::vector<std::vector<int> > &&accepts, const std::vector<int> &capacities,
+                               size_t numCourses) {
+                edges = std::move(accepts);
+                capacity = capacities;
+                owner.assign(numCourses, -1);
+                fill();
+                return owner;
+        };
+
+        /*
+         * After a match over numbered courses, offers one more course to the categories that
+         * accept it and gives it to the first category (in order) that can fill one more course
+         * with it, moving other courses between categories if needed. A category that could not
+         * be filled before can only get further with the new course, so this gives the same
+         * courses as matching again with it added.
+         * Returns false (and forgets the course) if no category gets any further.
+         */
+        bool offer(int course, const std::vector<int> &categories) {
+                for(auto it = categories.begin(); it != categories.end(); ++it) {
+                        edges[*it].push_back(course);
+                }
+                for(size_t c = 0; c < edges.size(); ++c) {
+                        if(load[c] < capacity[c]) {
+                                ++stamp;
+                                if(augment(c)) {
+                                        ++load[c];
+                                        return true;
+                                }
+                        }
+                }
+                for(auto it = categories.begin(); it != categories.end(); ++it) {
+                        edges[*it].pop_back();
+                }
+                return false;
+        };
+
+        // the category each numbered course was given to (-1 if none)
+        const std::vector<int> &getOwners() const {
+                return owner;
+        };
+};
+
+#endif
@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      RequirementProgram.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    The requirements of one major compiled for auditing: every
+//                 course they mention is numbered once, so auditing a
+//                 student only looks up their own courses and works on
+//                 those numbers from then on.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RequirementProgram_hpp
+#define RequirementProgram_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "MajorRequirements.hpp"
+#include "AuditResult.hpp"
+#include "RequirementMatcher.hpp"
+#include "Metrics.hpp"
+
+// how a course another major of the student already counts may be used (see MultiMajorAudit)
+enum CourseClaim {
+        CLAIM_NONE,// no other major counts it
+        CLAIM_SHARED,// it may count for this major too
+        CLAIM_HELD// it may not count toward this major's categories
+};
+
+/* A major's requirements as sets of course ids. Each distinct course of the required list
+ * and the categories gets an id; the required courses and each category's choices are
+ * kept as lists of ids (the categories in audit order, Electives last, with the number of
+ * courses each needs).
+ * An audit looks each completed course up once and then only indexes arrays by id instead
+ * of looking up every required course and choice of the major. Every audit (Student,
+ * StudentView, IncrementalAudit, MultiMajorAudit) goes through here.
+ * Compiled once per major (see RequirementsCache) and never changed afterwards, so it can
+ * be shared between threads.
+ */
+class RequirementProgram {
+
+private:
+        std::shared_ptr<const MajorRequirements> req;
+        std::unordered_map<CourseKey, uint32_t> ids;
+        std::vector<uint32_t> required;// id of each required course, in the order listed
+        std::vector<std::vector<uint32_t> > choices;// per category: id of each choice, in the order listed
+        std::vector<std::vector<int> > accepts;// per category: distinct ids of its choices
+        std::vector<int> capacities;// per category: courses needed
+        std::vector<std::vector<int> > acceptedBy;// per id: categories that accept it
+
+        // what a completed course may be used for, by id
+        enum {
+                DONE_NOT,// not completed
+                DONE_FREE,// any category
+                DONE_SHARED,// categories that may share courses with another major
+                DONE_HELD// no category
+        };
+
+        uint32_t intern(CourseKey key) {
+                return ids.insert(std::make_pair(key, (uint32_t)ids.size())).first->second;
+        };
+
+public:
+        explicit RequirementProgram(std::shared_ptr<const MajorRequirements> req) {
+                this->req = req;
+                for(auto it = req->required.begin(); it != req->required.end(); ++it) {
+                        required.push_back(intern((*it).getKey()));
+                }
+                choices.resize(req->categories.size());
+                accepts.resize(req->categories.size());
+                for(size_t c = 0; c < req->categories.size(); ++c) {
+                        const OptionCategory &category = req->categories[c];
+                        capacities.push_back(category.numRequired);
+                        for(auto it = category.courses.begin(); it != category.courses.end(); ++it) {
+                                choices[c].push_back(intern((*it).getKey()));
+                        }
+                }
+                std::vector<size_t> seen(ids.size(), 0);// removes duplicate choices
+                acceptedBy.resize(ids.size());
+                for(size_t c = 0; c < choices.size(); ++c) {
+                        for(auto it = choices[c].begin(); it != choices[c].end(); ++it) {
+                                if(seen[*it] != c + 1) {
+                                        seen[*it] = c + 1;
+                                        accepts[c].push_back((int)*it);
+                                        acceptedBy[*it].push_back((int)c);
+                                }
+                        }
+                }
+        };
+
+        const std::shared_ptr<const MajorRequirements> &getRequirements() const {
+                return req;
+        };
+
+        const std::string &getMajor() const {
+                return req->major;
+        };
+
+        // distinct courses the requirements mention
+        size_t size() const {
+                return ids.size();
+        };
+
+        // true if the requirements mention a course
+        bool contains(CourseKey key) const {
+                return ids.count(key) != 0;
+        };
+
+        /*
+         * The ids of the completed courses the requirements mention, sorted and without
+         * duplicates. A (single major) audit only depends on these, so two transcripts with the
+         * same ids get the same audit whatever else is on them (see AuditCache).
+         */
+        std::vector<uint32_t> courseIds(const std::vector<CourseKey> &completed) const {
+                std::vector<uint32_t> found;
+                for(auto it = completed.begin(); it != completed.end(); ++it) {
+                        auto id = ids.find(*it);
+                        if(id != ids.end()) {
+                                found.push_back(id->second);
+                        }
+                }
+                std::sort(found.begin(), found.end());
+                found.erase(std::unique(found.begin(), found.end()), found.end());
+                return found;
+        };
+
+        /*
+         * Audits the courses in result.completed and fills in the rest of result (its id, name,
+         * year and major are left alone).
+         */
+        AuditResult audit(AuditResult result) const {
+                int allowance = 0;
+                auditCourses(result, result.completed.data(), result.completed.data() + result.completed.size(),
+                             std::unordered_map<CourseKey, CourseClaim>(), std::unordered_set<std::string>(), allowance);
+                return result;
+        };
+
+        /*
+         * The same for the courses from first to last (eg. a CourseSpan of a StudentStore), which
+         * are read in place - result.completed is left alone.
+         */
+        AuditResult audit(AuditResult result, const CourseKey *first, const CourseKey *last) const {
+                int allowance = 0;
+                auditCourses(result, first, last, std::unordered_map<CourseKey, CourseClaim>(),
+                             std::unordered_set<std::string>(), allowance);
+                return result;
+        };
+
+        /*
+         * The same for one of several majors of a student (see MultiMajorAudit). The categories
+         * may not use the completed courses claims marks CLAIM_HELD. Those it marks CLAIM_SHARED
+         * are only offered to the categories not named in exclusive once every other course is
+         * placed, one at a time in transcript order, and only kept if they fill one more course.
+         * Each one kept takes one from allowance (-1 for no limit); none are offered at 0.
+         * Required courses count whatever their claim.
+         */
+        AuditResult audit(AuditResult result, const std::unordered_map<CourseKey, CourseClaim> &claims,
+                          const std::unordered_set<std::string> &exclusive, int &allowance) const {
+                auditCourses(result, result.completed.data(), result.completed.data() + result.completed.size(),
+                             claims, exclusive, allowance);
+                return result;
+        };
+
+        /*
+         * Matches the categories at positions (in audit order) again to the completed courses
+         * and replaces their results in categories, leaving the other categories alone.
+         * Categories which share no completed course never affect each other, so a group of
+         * them matched on its own gets the same courses as in a full audit (see
+         * IncrementalAudit).
+         */
+        void rematch(const std::vector<int> &positions, const std::vector<CourseKey> &completed,
+                     std::vector<CategoryResult> &categories) const {
+                std::vector<char> done(ids.size(), DONE_NOT);
+                for(auto it = completed.begin(); it != completed.end(); ++it) {
+                        auto found = ids.find(*it);
+                        if(found != ids.end()) {
+                                done[found->second] = DONE_FREE;
+                        }
+                }
+                std::vector<std::vector<int> > edges(accepts.size());
+                for(auto c = positions.begin(); c != positions.end(); ++c) {
+                        for(auto it = accepts[*c].begin(); it != accepts[*c].end(); ++it) {
+                                if(done[*it] == DONE_FREE) {
+                                        edges[*c].push_back(*it);
+                                }
+                        }
+                }
+                RequirementMatcher matcher;
+                std::vector<int> owner = matcher.match(std::move(edges), capacities, ids.size());
+                for(auto c = positions.begin(); c != positions.end(); ++c) {
+                        categories[*c] = categoryResult(*c, owner);
+                }
+        };
+
+private:
+        // audits the courses from first to last into result (see audit)
+        void auditCourses(AuditResult &result, const CourseKey *first, const CourseKey *last,
+                          const std::unordered_map<CourseKey, CourseClaim> &claims,
+                          const std::unordered_set<std::string> &exclusive, int &allowance) const {
+                static Counter &audits = Metrics::instance().counter("course_guide_audits_total", "Students audited");
+                static Histogram &auditTime = Metrics::stage("audit");
+                ScopedTimer timer(auditTime);
+                audits.add();
+                result.majorFound = true;
+                // completed courses the requirements do not mention can not count toward them
+                std::vector<char> done(ids.size(), DONE_NOT);
+                for(const CourseKey *it = first; it != last; ++it) {
+                        auto found = ids.find(*it);
+                        if(found != ids.end()) {
+                                done[found->second] = DONE_FREE;
+                        }
+                }
+                for(auto it = claims.begin(); it != claims.end(); ++it) {
+                        auto found = ids.find(it->first);
+                        if(found != ids.end() && done[found->second] != DONE_NOT && it->second != CLAIM_NONE) {
+                                done[found->second] = (it->second == CLAIM_SHARED) ? DONE_SHARED : DONE_HELD;
+                        }
+                }
+                for(size_t i = 0; i < required.size(); ++i) {
+                        if(done[required[i]] != DONE_NOT) {
+                                result.requiredCompleted.push_back(req->required[i]);
+                        } else {
+                                result.requiredRemaining.push_back(req->required[i]);
+                        }
+                }
+                // the shared courses in transcript order
+                std::vector<uint32_t> offers;
+                for(const CourseKey *it = first; it != last && !claims.empty(); ++it) {
+                        auto found = ids.find(*it);
+                        if(found != ids.end() && done[found->second] == DONE_SHARED) {
+                                offers.push_back(found->second);
+                                done[found->second] = DONE_HELD;// offered once
+                        }
+                }
+                std::vector<char> shares(choices.size(), 1);
+                for(size_t c = 0; c < choices.size() && !exclusive.empty(); ++c) {
+                        shares[c] = exclusive.count(req->categories[c].name) == 0;
+                }
+                result.setCategories(matchCategories(done, offers, shares, allowance));
+        };
+
+        /*
+         * Assigns the completed courses (those done marks DONE_FREE) to the categories, then
+         * offers the shared ones to the categories that may share (see audit).
+         */
+        std::vector<CategoryResult> matchCategories(const std::vector<char> &done, const std::vector<uint32_t> &offers,
+                                                    const std::vector<char> &shares, int &allowance) const {
+                static Histogram &matchTime = Metrics::stage("match");
+                ScopedTimer timer(matchTime);
+                std::vector<std::vector<int> > edges(accepts.size());
+                for(size_t c = 0; c < accepts.size(); ++c) {
+                        for(auto it = accepts[c].begin(); it != accepts[c].end(); ++it) {
+                                if(done[*it] == DONE_FREE) {
+                                        edges[c].push_back(*it);
+                                }
+                        }
+                }
+                RequirementMatcher matcher;
+                matcher.match(std::move(edges), capacities, ids.size());
+                for(auto it = offers.begin(); it != offers.end() && allowance != 0; ++it) {
+                        std::vector<int> takers;
+                        for(auto c = acceptedBy[*it].begin(); c != acceptedBy[*it].end(); ++c) {
+                                if(shares[*c]) {
+                                        takers.push_back(*c);
+                                }
+                        }
+                        if(!takers.empty() && matcher.offer((int)*it, takers) && allowance > 0) {
+                                --allowance;
+                        }
+                }
+                std::vector<int> owner = matcher.getOwners();
+
+                std::vector<CategoryResult> results(choices.size());
+                for(size_t c = 0; c < choices.size(); ++c) {
+                        results[c] = categoryResult(c, owner);
+                }
+                return results;
+        };
+
+        // the result of category c given the category owner gives each course to
+        CategoryResult categoryResult(size_t c, std::vector<int> &owner) const {
+                const OptionCategory &category = req->categories[c];
+                CategoryResult result;
+                result.name = category.name;
+                result.numRequired = category.numRequired;
+                // the courses used in the order of the choices (a duplicate choice only once)
+                std::vector<uint32_t> used;
+                for(size_t j = 0; j < choices[c].size(); ++j) {
+                        uint32_t id = choices[c][j];
+                        if(owner[id] == (int)c) {
+                                result.used.push_back(category.courses[j].getKey());
+                                used.push_back(id);
+                                owner[id] = -2;
+                        }
+                }
+                // classes used to fulfill this category are no longer options
+                for(size_t j = 0; j < choices[c].size(); ++j) {
+                        if(owner[choices[c][j]] != -2) {
+                                result.choices.push_back(category.courses[j]);
+                        }
+                }
+                for(auto it = used.begin(); it != used.end(); ++it) {
+                        owner[*it] = (int)c;
+                }
+                result.tally();
+                return result;
+        };
+};
+
+#endif
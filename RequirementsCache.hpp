@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      RequirementsCache.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Keeps the requirements of every major that has been loaded,
+//                 compiled into a RequirementProgram, so auditing another
+//                 student of the same major does not load them again.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RequirementsCache_hpp
+#define RequirementsCache_hpp
+
+#include <string>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include "MajorRequirements.hpp"
+#include "RequirementProgram.hpp"
+
+/* Caches MajorRequirements by major name, each compiled into a RequirementProgram when it
+ * is loaded. Entries are shared and never changed once cached, so a thread can keep
+ * auditing with requirements that another thread has since dropped from the cache. Majors
+ * that could not be found are remembered too.
+ * Like the CourseCatalog, the cache remembers the catalog version it was filled under
+ * and is cleared when that changes.
+ * Safe to share between threads.
+ */
+class RequirementsCache {
+
+private:
+        // a null pointer means the major could not be found
+        std::unordered_map<std::string, std::shared_ptr<const RequirementProgram> > majors;
+        std::string version;// catalog version the cached entries belong to
+        unsigned long hits, misses;
+        unsigned long generation;// counts clears so loads that straddle one are not cached
+        mutable std::mutex lock;
+
+public:
+        RequirementsCache() {
+                this->hits = 0;
+                this->misses = 0;
+                this->generation = 0;
+        };
+
+        RequirementsCache(const RequirementsCache &) = delete;
+        RequirementsCache &operator=(const RequirementsCache &) = delete;
+
+        /*
+         * Gets the requirements of a major. On a miss load(const std::string &major,
+         * MajorRequirements &req) is called to fill them in and returns false if the major
+         * does not exist. The lock is not held while loading, so two threads missing the
+         * same major may both load it.
+         * Returns a null pointer if the major does not exist. Exceptions from load are passed on
+         * (nothing is cached).
+         */
+        template<typename Loader>
+        std::shared_ptr<const MajorRequirements> get(const std::string &major, Loader load) {
+                std::shared_ptr<const RequirementProgram> program = getProgram(major, load);
+                return program ? program->getRequirements() : std::shared_ptr<const MajorRequirements>();
+        };
+
+        // the same for the compiled program of the requirements
+        template<typename Loader>
+        std::shared_ptr<const RequirementProgram> getProgram(const std::string &major, Loader load) {
+                unsigned long loadedIn;
+                {
+                        std::lock_guard<std::mutex> guard(lock);
+                        auto it = majors.find(major);
+                        if(it != majors.end()) {
+                                ++hits;
+                                return it->second;
+                        }
+                        ++misses;
+                        loadedIn = generation;
+                }
+                std::shared_ptr<MajorRequirements> req(new MajorRequirements());
+                std::shared_ptr<const RequirementProgram> loaded;
+                if(load(major, *req)) {
+                        loaded.reset(new RequirementProgram(req));
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                if(loadedIn != generation) {
+                        return loaded;// the cache was cleared while loading - may be stale
+                }
+                return majors.insert(std::make_pair(major, loaded)).first->second;
+        };
+
+        // drops every cached major
+        void clear() {
+                std::lock_guard<std::mutex> guard(lock);
+                majors.clear();
+                ++generation;
+        };
+
+        /*
+         * Clears the cache if the catalog version differs from the one it was filled under.
+         * Returns true if the cache was cleared.
+         */
+        bool checkVersion(const std::string &current) {
+                std::lock_guard<std::mutex> guard(lock);
+                if(current == version) {
+                        return false;
+                }
+                version = current;
+                bool stale = !majors.empty();
+                majors.clear();
+                ++generation;
+                return stale;
+        };
+
+        size_t size() const {
+                std::lock_guard<std::mutex> guard(lock);
+                return majors.size();
+        };
+
+        void printStats(std::ostream &out) const {
+                std::lock_guard<std::mutex> guard(lock);
+                out << "Requirements cache: " << majors.size() << " majors cached, "
+                    << hits << " hits, " << misses << " misses" << std::endl;
+        };
+};
+
+#endif
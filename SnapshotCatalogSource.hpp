@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      SnapshotCatalogSource.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Reads the course catalog from a memory mapped catalog
+//                 snapshot (see CatalogSnapshot) - no database needed.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SnapshotCatalogSource_hpp
+#define SnapshotCatalogSource_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "Course.hpp"
+#include "MajorRequirements.hpp"
+#include "CatalogSnapshot.hpp"
+#include "CatalogSource.hpp"
+
+/* loadRequirements, getCourseData and getPrerequisites go straight to the snapshot. The other calls are
+ * answered from the requirements of the major they name, found through an index of major
+ * ids built when the snapshot is opened.
+ * The snapshot is only read, so the source can be shared between threads once open.
+ */
+class SnapshotCatalogSource : public CatalogSource {
+
+private:
+        CatalogSnapshot snapshot;
+        std::unordered_map<int, std::string> majorNames;// major id -> name
+        std::map<std::string, std::string> electivesOf;// listing -> a major with Electives
+
+        MajorRequirements findMajor(int majorId) const {
+                MajorRequirements req;
+                auto name = majorNames.find(majorId);
+                if(name != majorNames.end()) {
+                        snapshot.getRequirements(name->second, req);
+                }
+                return req;
+        };
+
+public:
+        SnapshotCatalogSource() {
+        };
+
+        /*
+         * Opens a snapshot file.
+         * Returns false and describes the problem in error if it can not be used.
+         */
+        bool open(const std::string &path, std::string &error) {
+                if(!snapshot.open(path, error)) {
+                        return false;
+                }
+                std::vector<std::string> names = snapshot.getMajorNames();
+                for(auto it = names.begin(); it != names.end(); ++it) {
+                        MajorRequirements req;
+                        snapshot.getRequirements(*it, req);
+                        majorNames[req.id] = *it;
+                        if(!req.categories.empty() && req.categories.back().name == "Electives") {
+                                electivesOf.insert(std::make_pair(req.listing, *it));
+                        }
+                }
+                return true;
+        };
+
+        bool getMajorId(const std::string &major, int &id) override {
+                MajorRequirements req;
+                if(!snapshot.getRequirements(major, req)) {
+                        return false;
+                }
+                id = req.id;
+                return true;
+        };
+
+        std::vector<Course> getRequiredCourses(int majorId) override {
+                return findMajor(majorId).required;
+        };
+
+        std::map<std::string, int> getMajorOptions(int majorId) override {
+                std::map<std::string, int> options;
+                MajorRequirements req = findMajor(majorId);
+                for(auto it = req.categories.begin(); it != req.categories.end(); ++it) {
+                        options[it->name] = it->numRequired;
+                }
+                return options;
+        };
+
+        std::vector<Course> getOptionalElectives(const std::string &category, int majorId) override {
+                MajorRequirements req = findMajor(majorId);
+                for(auto it = req.categories.begin(); it != req.categories.end(); ++it) {
+                        if(it->name == category) {
+                                return it->courses;
+                        }
+                }
+                return std::vector<Course>();
+        };
+
+        std::string getListing(int majorId) override {
+                return findMajor(majorId).listing;
+        };
+
+        // the snapshot only holds the electives of listings that one of its majors uses
+        std::vector<Course> getElectives(const std::string &listing) override {
+                auto major = electivesOf.find(listing);
+                MajorRequirements req;
+                if(major == electivesOf.end() || !snapshot.getRequirements(major->second, req)) {
+                        return std::vector<Course>();
+                }
+                return req.categories.back().courses;
+        };
+
+        void getCourseData(std::vector<Course> &courses) override {
+                for(auto it = courses.begin(); it != courses.end(); ++it) {
+                        snapshot.getCourse(*it);
+                }
+        };
+
+        std::string getCatalogVersion() override {
+                return snapshot.getCatalogVersion();
+        };
+
+        bool loadRequirements(const std::string &major, MajorRequirements &req) override {
+                return snapshot.getRequirements(major, req);
+        };
+
+        std::vector<Course> getPrerequisites(const Course &course) override {
+                return snapshot.getPrerequisites(course);
+        };
+
+        bool providesPrerequisites() override {
+                return true;
+        };
+};
+
+#endif
@@ -19,6 +19,9 @@
 #include <string>
 #include <iostream>
 #include "Course.hpp"
+#include "RequirementProgram.hpp"
+#include "TranscriptParser.hpp"
+#include "AuditResult.hpp"
 #include <algorithm>
 #include <fstream>
 
@@ -31,8 +34,29 @@ class Student {
 private:
         int year;// 1=freshman, 4=senior
         std::string id, name, major;
-        std::vector<Course> completed;// courses that have been passed
-        std::vector<Course> usedToFulfillOption;// classes that have been used to fulfill elective options 
+        std::vector<CourseKey> completed;// courses that have been passed
+        std::vector<CourseKey> usedToFulfillOption;// classes that have been used to fulfill elective options 
+
+        // keeps the keys of the valid courses in the list
+        static std::vector<CourseKey> toKeys(const std::vector<Course> &courses) {
+                std::vector<CourseKey> keys;
+                keys.reserve(courses.size());
+                for(auto it = courses.begin(); it != courses.end(); ++it) {
+                        if((*it).isValid()) {
+                                keys.push_back((*it).getKey());
+                        }
+                }
+                return keys;
+        };
+
+        // notes the courses an audit of this student used to fulfill the categories
+        void rememberUsed(const AuditResult &result) {
+                usedToFulfillOption.clear();
+                const std::vector<CategoryResult> &categories = result.getCategories();
+                for(auto it = categories.begin(); it != categories.end(); ++it) {
+                        usedToFulfillOption.insert(usedToFulfillOption.end(), it->used.begin(), it->used.end());
+                }
+        };
 
 public:
         Student() {
@@ -43,54 +67,101 @@ public:
         };
 
  	// populate student data with a text file
-        Student(std::string filename) {
+        Student(const std::string &filename) {
 		std::ifstream inFile;	
 		inFile.open(filename);
 		processStudent(inFile);
 	}
 
+        // create a student from a record read by a TranscriptParser
+        Student(const TranscriptRecord &record) {
+                this->id = std::string(record.id);
+                this->year = record.year;
+                this->name = std::string(record.name);
+                this->major = std::string(record.major);
+                record.forEachCourse([this](CourseKey key) {
+                        completed.push_back(key);
+                });
+        };
+
         Student(std::string id, int year, std::string name, std::string major,
         std::vector<Course> &completed) {
                 this->id = id;
                 this->year = year;
                 this->name = name;
                 this->major = major;
-                this->completed = completed;
+                this->completed = toKeys(completed);
         };
 
-        void printStudentData() {
-		std::cout << "Name: " << name << std::endl;
- 		std::cout << "Year: " << year << std::endl;
-		std::cout << "Major: " << major << std::endl;
-		std::cout << "ID: " << id << std::endl;
-                std::cout << "Completed Classes: " << std::endl;
+        void printStudentData(std::ostream &out = std::cout) const {
+		out << "Name: " << name << std::endl;
+ 		out << "Year: " << year << std::endl;
+		out << "Major: " << major << std::endl;
+		out << "ID: " << id << std::endl;
+                out << "Completed Classes: " << std::endl;
                 for(auto it = completed.begin(); it != completed.end(); ++it) {
- 			std::cout << " ";
-			(*it).printId();
+ 			out << " " << (*it).toString() << std::endl;
 		}
 	}
 
-        std::string getId() {
+        const std::string &getId() const {
                 return id;
         };
 
-        int getYear() {
+        int getYear() const {
                 return year;
         };
 
-        std::string getName() {
+        const std::string &getName() const {
                 return name;
         };
 
-        std::string getMajor() {
+        const std::string &getMajor() const {
                 return major;
         };
 
-        const std::vector<Course> getCompleted() {
+        /*
+         * The majors (and certificates) of a student with several, which are listed in the
+         * major field separated by ';' ("Computer Science; Mathematics"). A student with one
+         * major gets it alone.
+         */
+        std::vector<std::string> getMajors() const {
+                return splitMajors(major);
+        };
+
+        // the majors listed in a major field (see getMajors)
+        static std::vector<std::string> splitMajors(const std::string &major) {
+                std::vector<std::string> majors;
+                if(major.find(';') == std::string::npos) {
+                        majors.push_back(major);
+                        return majors;
+                }
+                std::stringstream ss(major);
+                std::string token;
+                while(getline(ss, token, ';')) {
+                        size_t first = token.find_first_not_of(" \t");
+                        size_t last = token.find_last_not_of(" \t");
+                        if(first != std::string::npos) {
+                                majors.push_back(token.substr(first, last - first + 1));
+                        }
+                }
+                if(majors.empty()) {
+                        majors.push_back(major);
+                }
+                return majors;
+        };
+
+        // the completed courses as Courses holding only their ids (use getCompletedKeys to avoid the copy)
+        std::vector<Course> getCompleted() const {
+                return std::vector<Course>(completed.begin(), completed.end());
+        };
+
+        // the keys of the completed courses (no copy)
+        const std::vector<CourseKey> &getCompletedKeys() const {
                 return completed;
         };
 
-        void setId(std::string id) {
+        void setId(const std::string &id) {
                 this->id = id;
         };
 
@@ -98,27 +169,29 @@ public:
                 this->year = year;
         };
 
-        void setName(std::string name) {
+        void setName(const std::string &name) {
                 this->name = name;
         };
 
-        void setMajor(std::string major) {
+        void setMajor(const std::string &major) {
                 this->major = major;
         };
 
-        void setCompleted(std::vector<Course> completed) {
-                this->completed = completed;
+        void setCompleted(const std::vector<Course> &completed) {
+                this->completed = toKeys(completed);
         };
 
         // Below are student processing functions
-        std::vector<Course> populateClasses(std::string line) {
-                std::vector<Course> classes;
+        // parses a comma separated list of course ids - ids which are not valid are skipped
+        std::vector<CourseKey> populateClasses(std::string line) {
+                std::vector<CourseKey> classes;
                 std::stringstream ss(line);
                 std::string token;
                 while(getline(ss, token, ',')) {
-                        Course c(token);
-                	
-                        classes.push_back(c);
+                        CourseKey key = CourseKey::parse(token);
+                	if(key.isValid()) {
+                                classes.push_back(key);
+                        }
                 };
                 return classes;
         };
@@ -129,68 +202,37 @@ public:
                 while(getline(inFile, line)) {
                         // extract info
                         switch(num) {
-                                case 0: setId(line);
-                                case 1: setYear(atoi(line.c_str()));
-                                case 2: setName(line);
-                                case 3: setMajor(line);
-                                case 4: completed = populateClasses(line);
+                                case 0: setId(line); break;
+                                case 1: setYear(atoi(line.c_str())); break;
+                                case 2: setName(line); break;
+                                case 3: setMajor(line); break;
+                                case 4: completed = populateClasses(line); break;
                         }
                         num++;
                 };
 
         };
 
+        // a result holding this student's info - the audit fills in the rest
+        AuditResult newResult() const {
+                AuditResult result;
+                result.id = id;
+                result.name = name;
+                result.year = year;
+                result.major = major;
+                result.completed = completed;
+                return result;
+        }
+
         /*
-         * Determines if the student has fulfilled the elective requirement. 
-	 * If yes -> Mark this class as having fulfilled this req
-	 * If no -> print a list of courses that the student can choose from
-	 */
-	void isFulfilled(std::string option_name, std::vector<Course> class_choices, int numRequired) {
-        	std::cout << option_name << ":" << std::endl;
-		// determine if the any of the classes have been taken
- 		for(auto it = class_choices.begin(); it != class_choices.end(); ++it) {
-       			for(auto it_completed = completed.begin(); it_completed != completed.end(); ++it_completed) {
-				// check if the student has already completed a course on the list
-			 	if((*it).getCourseNum().compare((*it_completed).getCourseNum()) == 0) {
-					// must confirm this class is not already being used to fulfill some other req
-                                        bool alreadyUsed = false;
-					for(auto itr = usedToFulfillOption.begin(); itr != usedToFulfillOption.end(); ++itr) {
-						if((*it).getCourseNum().compare((*itr).getCourseNum()) == 0) {
- 							alreadyUsed = true;
-							break;
-						}
-					}
-					// use this class to fulfill this requirement
-					if(!alreadyUsed) {
-						std::cout << " " << (*it).getCourseNum() << " can be used to fulfill this requirement." 
-							<< std::endl;
-                                        	usedToFulfillOption.push_back(*it);
-						// remove this class form the options list
-						class_choices.erase(std::find(class_choices.begin(), class_choices.end(),
-								*it));
-						--numRequired;
-						//  this req has been satisfied if numRequired=0
-						if(numRequired == 0) {
-							std::cout << " You've completed the " << option_name << " requirement." << std::endl;
-							return;
-						}
-					}
-				}	
-			}	
-		}
-		// print a list of the class options along with the name of the class and how mnay courses must be taken
-                std::cout << " You must take " << numRequired;
-                if(numRequired > 1) {
-			std::cout << " more classes ";
- 		} else {
-			std::cout << " more class ";
-		}
-		std::cout << "from the " << option_name << " category." << std::endl;
-		std::cout << " A list of your choices:" << std::endl;
-		for(auto it = class_choices.begin(); it != class_choices.end(); ++it) {
-  			std::cout << " -";
-			(*it).printData();
-		}
+         * Audits the student against the compiled requirements of their major (see
+         * RequirementProgram). Splits the required courses into completed and remaining ones
+         * and determines which option categories have been fulfilled.
+         */
+        AuditResult audit(const RequirementProgram &program) {
+                AuditResult result = program.audit(newResult());
+                rememberUsed(result);
+                return result;
         }
 
 };
@@ -0,0 +1,314 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      StudentStore.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Holds a whole cohort of students in a handful of flat
+//                 arrays instead of one Student object each. Students are
+//                 read through StudentViews, which point into the store and
+//                 copy nothing.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef StudentStore_hpp
+#define StudentStore_hpp
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "CourseKey.hpp"
+#include "MajorRequirements.hpp"
+#include "AuditResult.hpp"
+#include "TranscriptParser.hpp"
+#include "MappedFile.hpp"
+#include "Student.hpp"
+
+// the completed courses of one student - a view into the store's course arena
+class CourseSpan {
+
+private:
+        const CourseKey *first, *last;
+
+public:
+        CourseSpan(const CourseKey *first, const CourseKey *last) {
+                this->first = first;
+                this->last = last;
+        };
+
+        const CourseKey *begin() const {
+                return first;
+        };
+
+        const CourseKey *end() const {
+                return last;
+        };
+
+        size_t size() const {
+                return last - first;
+        };
+
+        bool empty() const {
+                return first == last;
+        };
+
+        CourseKey operator[](size_t i) const {
+                return first[i];
+        };
+};
+
+class StudentStore;
+
+/* One student of a StudentStore. A view is two words and is passed by value; the strings
+ * and courses it returns point into the store, so they are only valid until the store is
+ * changed (like iterators of a vector).
+ */
+class StudentView {
+
+private:
+        const StudentStore *store;
+        size_t index;
+
+public:
+        StudentView(const StudentStore &store, size_t index) {
+                this->store = &store;
+                this->index = index;
+        };
+
+        size_t getIndex() const {
+                return index;
+        };
+
+        // defined after StudentStore
+        std::string_view getId() const;
+        std::string_view getName() const;
+        std::string_view getMajor() const;
+        const std::vector<uint32_t> &getMajorIndexes() const;// each major listed, in order
+        int getYear() const;
+        CourseSpan getCompleted() const;
+
+        // a result holding the student's info but not their courses
+        AuditResult newInfo() const {
+                AuditResult result;
+                result.id = std::string(getId());
+                result.name = std::string(getName());
+                result.major = std::string(getMajor());
+                result.year = getYear();
+                return result;
+        };
+
+        // a result holding the student's info and a copy of their courses - the audit fills in the rest
+        AuditResult newResult() const {
+                AuditResult result = newInfo();
+                CourseSpan completed = getCompleted();
+                result.completed.assign(completed.begin(), completed.end());
+                return result;
+        };
+
+        /*
+         * Audits the student against the compiled requirements of their major (see
+         * Student::audit). The courses are read in place from the store, so the result's
+         * completed list is left empty.
+         */
+        AuditResult audit(const RequirementProgram &program) const {
+                CourseSpan completed = getCompleted();
+                return program.audit(newInfo(), completed.begin(), completed.end());
+        };
+
+        // a Student holding a copy of this one
+        Student toStudent() const {
+                std::vector<Course> completed;
+                CourseSpan courses = getCompleted();
+                completed.assign(courses.begin(), courses.end());
+                return Student(std::string(getId()), getYear(), std::string(getName()), std::string(getMajor()),
+                               completed);
+        };
+};
+
+/* The students are kept as a structure of arrays, one entry per student in each column:
+ *   years, major fields (an index into the list of distinct major fields, each of which
+ *   lists the index of every major it names in the list of distinct majors, so students
+ *   can be grouped by major without comparing strings), and offsets into two arenas: one
+ *   string holding every id and name back to back and one array holding every completed
+ *   course.
+ * Adding a student appends to the columns and arenas, so loading a whole cohort costs a
+ * few allocations per column rather than several per student, and walking the students
+ * reads memory in order. load() counts a file before reading it so each column is
+ * allocated once.
+ * Nothing is locked: fill the store before sharing it between threads and only read it
+ * afterwards.
+ */
+class StudentStore {
+
+private:
+        friend class StudentView;
+
+        std::string text;// id then name of every student
+        std::vector<uint32_t> textAt;// where each student's id starts (one more entry at the end)
+        std::vector<uint32_t> nameAt;// where each student's name starts
+        std::vector<CourseKey> courses;// completed courses of every student
+        std::vector<uint32_t> coursesAt;// where each student's courses start (one more entry at the end)
+        std::vector<int> years;
+        std::vector<uint32_t> fieldOf;
+        std::vector<std::string> fields;// distinct major fields in the order first seen
+        std::vector<std::vector<uint32_t> > fieldMajors;// per field: the majors it lists
+        std::unordered_map<std::string, uint32_t> fieldIndex;
+        std::vector<std::string> majors;// distinct majors in the order first seen
+        std::unordered_map<std::string, uint32_t> majorIndex;
+
+        // the index of a major field, splitting a new one into its majors (see Student::getMajors)
+        uint32_t findField(const std::string &field) {
+                auto found = fieldIndex.find(field);
+                if(found != fieldIndex.end()) {
+                        return found->second;
+                }
+                std::vector<uint32_t> listed;
+                std::vector<std::string> names = Student::splitMajors(field);
+                for(auto it = names.begin(); it != names.end(); ++it) {
+                        auto major = majorIndex.insert(std::make_pair(*it, (uint32_t)majors.size())).first;
+                        if(major->second == majors.size()) {
+                                majors.push_back(*it);
+                        }
+                        listed.push_back(major->second);
+                }
+                fieldIndex.insert(std::make_pair(field, (uint32_t)fields.size()));
+                fields.push_back(field);
+                fieldMajors.push_back(listed);
+                return (uint32_t)fields.size() - 1;
+        };
+
+        // the number of ids in a comma separated course list (may count ids that are not valid)
+        static size_t countCourses(std::string_view list) {
+                return list.empty() ? 0 : std::count(list.begin(), list.end(), ',') + 1;
+        };
+
+public:
+        StudentStore() {
+                textAt.push_back(0);
+                coursesAt.push_back(0);
+        };
+
+        // makes room for more students, their courses and the bytes of their ids and names
+        void reserve(size_t students, size_t numCourses, size_t textBytes) {
+                years.reserve(years.size() + students);
+                fieldOf.reserve(fieldOf.size() + students);
+                nameAt.reserve(nameAt.size() + students);
+                textAt.reserve(textAt.size() + students);
+                coursesAt.reserve(coursesAt.size() + students);
+                courses.reserve(courses.size() + numCourses);
+                text.reserve(text.size() + textBytes);
+        };
+
+        // adds the student of a record (course ids which are not valid are skipped)
+        void add(const TranscriptRecord &record) {
+                text.append(record.id.data(), record.id.size());
+                nameAt.push_back((uint32_t)text.size());
+                text.append(record.name.data(), record.name.size());
+                textAt.push_back((uint32_t)text.size());
+                record.forEachCourse([this](CourseKey key) {
+                        courses.push_back(key);
+                });
+                coursesAt.push_back((uint32_t)courses.size());
+                years.push_back(record.year);
+                fieldOf.push_back(findField(std::string(record.major)));
+        };
+
+        /*
+         * Adds every student in a transcript file (see TranscriptParser for the layouts).
+         * Returns false and describes the problem in error if the file can not be read or is
+         * malformed; the students read before the problem stay in the store.
+         */
+        bool load(const std::string &path, std::string &error) {
+                MappedFile file;
+                if(!file.open(path, error, true)) {
+                        return false;
+                }
+                try {
+                        // count first so every column is allocated once
+                        size_t students = 0, numCourses = 0, textBytes = 0;
+                        TranscriptParser counter(file.getData(), file.getSize(), path);
+                        counter.parse([&](const TranscriptRecord &record) {
+                                ++students;
+                                numCourses += countCourses(record.courses);
+                                textBytes += record.id.size() + record.name.size();
+                        });
+                        reserve(students, numCourses, textBytes);
+                        TranscriptParser parser(file.getData(), file.getSize(), path);
+                        parser.parse([this](const TranscriptRecord &record) {
+                                add(record);
+                        });
+                }
+                catch(TranscriptError &e) {
+                        error = e.what();
+                        return false;
+                }
+                return true;
+        };
+
+        size_t size() const {
+                return years.size();
+        };
+
+        bool empty() const {
+                return years.empty();
+        };
+
+        StudentView operator[](size_t i) const {
+                return StudentView(*this, i);
+        };
+
+        // the distinct majors - StudentView::getMajorIndexes indexes this list
+        const std::vector<std::string> &getMajors() const {
+                return majors;
+        };
+
+        size_t getNumCourses() const {
+                return courses.size();
+        };
+
+        // bytes held by the columns and arenas
+        size_t memoryUsage() const {
+                size_t bytes = text.capacity() + courses.capacity() * sizeof(CourseKey)
+                               + (textAt.capacity() + nameAt.capacity() + coursesAt.capacity()
+                                  + fieldOf.capacity()) * sizeof(uint32_t)
+                               + years.capacity() * sizeof(int);
+                for(auto it = majors.begin(); it != majors.end(); ++it) {
+                        bytes += it->capacity();
+                }
+                for(size_t f = 0; f < fields.size(); ++f) {
+                        bytes += fields[f].capacity() + fieldMajors[f].capacity() * sizeof(uint32_t);
+                }
+                return bytes;
+        };
+};
+
+inline std::string_view StudentView::getId() const {
+        return std::string_view(store->text.data() + store->textAt[index],
+                                store->nameAt[index] - store->textAt[index]);
+}
+
+inline std::string_view StudentView::getName() const {
+        return std::string_view(store->text.data() + store->nameAt[index],
+                                store->textAt[index + 1] - store->nameAt[index]);
+}
+
+inline std::string_view StudentView::getMajor() const {
+        return store->fields[store->fieldOf[index]];
+}
+
+inline const std::vector<uint32_t> &StudentView::getMajorIndexes() const {
+        return store->fieldMajors[store->fieldOf[index]];
+}
+
+inline int StudentView::getYear() const {
+        return store->years[index];
+}
+
+inline CourseSpan StudentView::getCompleted() const {
+        const CourseKey *base = store->courses.data();
+        return CourseSpan(base + store->coursesAt[index], base + store->coursesAt[index + 1]);
+}
+
+#endif
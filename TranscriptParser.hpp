@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      TranscriptParser.hpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Reads student transcripts out of a memory mapped file (or
+//                 any buffer) without copying. Accepts the Student.txt
+//                 layout and a one student per line layout, so one file
+//                 can hold a whole registrar export.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TranscriptParser_hpp
+#define TranscriptParser_hpp
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <stdexcept>
+#include "CourseKey.hpp"
+#include "MappedFile.hpp"
+
+// a malformed transcript - what() names the source and line of the problem
+class TranscriptError : public std::runtime_error {
+
+private:
+        size_t line;
+
+public:
+        TranscriptError(const std::string &source, size_t line, const std::string &message)
+                : std::runtime_error(source + ":" + std::to_string(line) + ": " + message) {
+                this->line = line;
+        };
+
+        size_t getLine() const {
+                return line;
+        };
+};
+
+/* One student as it appears in the input. The views point into the parsed buffer,
+ * so a record is only valid until the buffer goes away.
+ */
+struct TranscriptRecord {
+        size_t line;// line the student starts on
+        std::string_view id, name, major;
+        int year;
+        std::string_view courses;// comma separated course ids
+
+        /*
+         * Calls f with the CourseKey of every course id in the course list.
+         * Ids which are not valid are skipped.
+         */
+        template<typename Function>
+        void forEachCourse(Function f) const {
+                std::string_view rest = courses;
+                while(!rest.empty()) {
+                        std::string_view::size_type comma = rest.find(',');
+                        CourseKey key = CourseKey::parse(rest.substr(0, comma));
+                        if(key.isValid()) {
+                                f(key);
+                        }
+                        if(comma == std::string_view::npos) {
+                                break;
+                        }
+                        rest.remove_prefix(comma + 1);
+                }
+        };
+};
+
+/* Splits a buffer into TranscriptRecords. Two layouts are accepted and may be mixed:
+ *
+ * Student.txt layout - a block of lines separated from the next student by a blank line:
+ *   id
+ *   year
+ *   name
+ *   major
+ *   course,course,...
+ *
+ * One student per line - the same five fields separated by '|':
+ *   id|year|name|major|course,course,...
+ *
+ * A block whose first line contains a '|' is read one student per line.
+ * Nothing is copied or allocated per field - the records are views into the buffer.
+ */
+class TranscriptParser {
+
+private:
+        const char *pos, *end;
+        size_t lineNum;// number of the last line read
+        std::string source;
+
+        // the next line without its line ending (false at the end of the buffer)
+        bool nextLine(std::string_view &line) {
+                if(pos >= end) {
+                        return false;
+                }
+                const char *newline = (const char *)std::memchr(pos, '\n', end - pos);
+                const char *stop = (newline == NULL) ? end : newline;
+                line = std::string_view(pos, stop - pos);
+                if(!line.empty() && line.back() == '\r') {
+                        line.remove_suffix(1);
+                }
+                pos = (newline == NULL) ? end : newline + 1;
+                ++lineNum;
+                return true;
+        };
+
+        static bool isBlank(std::string_view line) {
+                for(auto it = line.begin(); it != line.end(); ++it) {
+                        if(*it != ' ' && *it != '\t') {
+                                return false;
+                        }
+                }
+                return true;
+        };
+
+        static std::string_view trim(std::string_view field) {
+                while(!field.empty() && (field.front() == ' ' || field.front() == '\t')) {
+                        field.remove_prefix(1);
+                }
+                while(!field.empty() && (field.back() == ' ' || field.back() == '\t')) {
+                        field.remove_suffix(1);
+                }
+                return field;
+        };
+
+        int parseYear(std::string_view field, size_t line) const {
+                field = trim(field);
+                if(field.empty() || field.length() > 2) {
+                        throw TranscriptError(source, line, "expected a year but found \"" + std::string(field) + "\"");
+                }
+                int year = 0;
+                for(auto it = field.begin(); it != field.end(); ++it) {
+                        if(*it < '0' || *it > '9') {
+                                throw TranscriptError(source, line,
+                                                "expected a year but found \"" + std::string(field) + "\"");
+                        }
+                        year = year * 10 + (*it - '0');
+                }
+                return year;
+        };
+
+        // splits "id|year|name|major|courses"
+        TranscriptRecord parseLine(std::string_view line) const {
+                std::string_view fields[5];
+                int count = 0;
+                while(count < 4) {
+                        std::string_view::size_type bar = line.find('|');
+                        if(bar == std::string_view::npos) {
+                                break;
+                        }
+                        fields[count++] = line.substr(0, bar);
+                        line.remove_prefix(bar + 1);
+                }
+                fields[count++] = line;
+                if(count < 4) {
+                        throw TranscriptError(source, lineNum, "expected id|year|name|major|courses");
+                }
+                TranscriptRecord record;
+                record.line = lineNum;
+                record.id = trim(fields[0]);
+                record.year = parseYear(fields[1], lineNum);
+                record.name = trim(fields[2]);
+                record.major = trim(fields[3]);
+                record.courses = (count == 5) ? fields[4] : std::string_view();
+                return record;
+        };
+
+public:
+        // firstLine is the line number the buffer starts at in source (for error messages)
+        TranscriptParser(const char *data, size_t size, std::string source, size_t firstLine = 1) {
+                this->pos = data;
+                this->end = data + size;
+                this->lineNum = firstLine - 1;
+                this->source = source;
+        };
+
+        /*
+         * Calls onRecord(const TranscriptRecord &) for every student in the buffer in order.
+         * Returns the number of students read.
+         * Throws a TranscriptError naming the line of the first malformed student.
+         */
+        template<typename Function>
+        size_t parse(Function onRecord) {
+                size_t count = 0;
+                std::string_view line;
+                while(true) {
+                        // skip the blank lines between students
+                        do {
+                                if(!nextLine(line)) {
+                                        return count;
+                                }
+                        } while(isBlank(line));
+                        size_t start = lineNum;
+
+                        if(line.find('|') != std::string_view::npos) {
+                                // one student per line until the end of the block
+                                do {
+                                        onRecord(parseLine(line));
+                                        ++count;
+                                } while(nextLine(line) && !isBlank(line));
+                                continue;
+                        }
+
+                        // Student.txt layout - the lines of the block are the fields in order
+                        TranscriptRecord record;
+                        record.line = start;
+                        record.id = trim(line);
+                        std::string_view fields[4];
+                        int numFields = 0;
+                        while(nextLine(line) && !isBlank(line)) {
+                                if(numFields == 4) {
+                                        throw TranscriptError(source, lineNum,
+                                                        "unexpected line after the course list of the student on line "
+                                                        + std::to_string(start));
+                                }
+                                fields[numFields++] = line;
+                        }
+                        if(numFields < 3) {
+                                throw TranscriptError(source, start,
+                                                "student is missing fields (expected id, year, name, major and courses)");
+                        }
+                        record.year = parseYear(fields[0], start + 1);
+                        record.name = trim(fields[1]);
+                        record.major = trim(fields[2]);
+                        record.courses = fields[3];
+                        onRecord(record);
+                        ++count;
+                }
+        };
+
+        /*
+         * Maps a transcript file and calls onRecord for every student in it.
+         * Throws a TranscriptError if the file can not be read or is malformed.
+         */
+        template<typename Function>
+        static size_t parseFile(const std::string &path, Function onRecord) {
+                MappedFile file;
+                std::string error;
+                if(!file.open(path, error, true)) {
+                        throw TranscriptError(path, 0, error);
+                }
+                TranscriptParser parser(file.getData(), file.getSize(), path);
+                return parser.parse(onRecord);
+        };
+};
+
+#endif
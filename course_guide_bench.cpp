@@ -0,0 +1,509 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      course_guide_bench.cpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Benchmarks the stages of an audit on a synthetic catalog
+//                 and synthetic transcripts, without a database. Each stage
+//                 (parsing, loading requirements, course lookups, matching
+//                 and reporting) is timed on its own and can be compared
+//                 against a stored baseline to catch regressions.
+///////////////////////////////////////////////////////////////////////////////
+
+// Note: Must use the following tags to compile:
+//       -std=c++17 -O2
+//       (no MySQL connector needed)
+
+// include standard c++ libs
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_set>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <unistd.h>
+// include custom classes
+#include "Course.hpp"
+#include "CourseKey.hpp"
+#include "CourseCatalog.hpp"
+#include "MajorRequirements.hpp"
+#include "CatalogSnapshot.hpp"
+#include "TranscriptParser.hpp"
+#include "Student.hpp"
+#include "AuditResult.hpp"
+#include "ReportWriter.hpp"
+#include "IncrementalAudit.hpp"
+#include "StudentStore.hpp"
+#include "RequirementProgram.hpp"
+#include "AuditCache.hpp"
+
+// the size of one synthetic data set
+struct BenchConfig {
+  std::string name;
+  int courses;// completed courses per student
+  int categories;// option categories per major (the last one is Electives)
+  int poolSize;// courses to choose from in each category
+  int students;
+  int majors;
+};
+
+// the best (lowest) time of each stage of one configuration
+struct BenchResult {
+  BenchConfig config;
+  std::map<std::string, double> stageMs;
+};
+
+// define funcitons
+void printUsage();
+std::vector<Course> makeCatalog(std::mt19937 &rng);
+std::vector<MajorRequirements> makeMajors(std::mt19937 &rng, const BenchConfig &config,
+                                          const std::vector<Course> &catalog);
+std::string makeTranscripts(std::mt19937 &rng, const BenchConfig &config,
+                            const std::vector<MajorRequirements> &majors, const std::vector<Course> &catalog);
+BenchResult runConfig(const BenchConfig &config, int iterations, unsigned int seed);
+bool readBaseline(const std::string &path, std::map<std::string, double> &baseline);
+bool writeBaseline(const std::string &path, const std::vector<BenchResult> &results);
+void printResults(const std::vector<BenchResult> &results, std::ostream &out);
+
+// the stages in the order they run
+const char *STAGES[] = { "parse", "load", "lookup", "match", "report", "reaudit", "store", "cached" };
+// stages which redo work another stage did - not part of the time per student
+const char *REDO_STAGES[] = { "reaudit", "store", "cached" };
+
+int main(int argc, char* argv[]) {
+  int courses = 0, categories = 0, students = 0, poolSize = 50, iterations = 5;
+  unsigned int seed = 368;
+  double tolerance = 25;// percent slower than the baseline that counts as a regression
+  std::string baselineFile, saveFile, outFile;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(i + 1 >= argc) {
+      printUsage();
+      return 1;
+    }
+    if(arg == "--courses") {
+      courses = atoi(argv[++i]);
+    } else if(arg == "--categories") {
+      categories = atoi(argv[++i]);
+    } else if(arg == "--students") {
+      students = atoi(argv[++i]);
+    } else if(arg == "--pool") {
+      poolSize = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--iterations") {
+      iterations = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--seed") {
+      seed = atoi(argv[++i]);
+    } else if(arg == "--tolerance") {
+      tolerance = atof(argv[++i]);
+    } else if(arg == "--baseline") {
+      baselineFile = argv[++i];
+    } else if(arg == "--save-baseline") {
+      saveFile = argv[++i];
+    } else if(arg == "--out") {
+      outFile = argv[++i];
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  // without --courses/--categories every combination of the standard sizes is run
+  std::vector<int> courseSizes = { 10, 100, 1000, 10000 };
+  std::vector<int> categorySizes = { 1, 10, 100 };
+  if(courses > 0) {
+    courseSizes.assign(1, std::min(courses, 10000));
+  }
+  if(categories > 0) {
+    categorySizes.assign(1, std::min(categories, 100));
+  }
+  std::vector<BenchConfig> configs;
+  for(auto c = courseSizes.begin(); c != courseSizes.end(); ++c) {
+    for(auto k = categorySizes.begin(); k != categorySizes.end(); ++k) {
+      BenchConfig config;
+      config.name = "c" + std::to_string(*c) + "-k" + std::to_string(*k);
+      config.courses = *c;
+      config.categories = *k;
+      config.poolSize = poolSize;
+      // keep the work per configuration about the same - fewer students when each is bigger
+      int perStudent = *c + *k * poolSize;
+      config.students = (students > 0) ? students : std::min(2000, std::max(20, 400000 / perStudent));
+      config.majors = 8;
+      configs.push_back(config);
+    }
+  }
+
+  std::vector<BenchResult> results;
+  for(auto it = configs.begin(); it != configs.end(); ++it) {
+    results.push_back(runConfig(*it, iterations, seed));
+  }
+  printResults(results, std::cout);
+  if(!outFile.empty()) {
+    std::ofstream out(outFile);
+    printResults(results, out);
+  }
+
+  if(!saveFile.empty()) {
+    if(!writeBaseline(saveFile, results)) {
+      std::cerr << "Could not write " << saveFile << std::endl;
+      return 1;
+    }
+    std::cout << "Saved baseline to " << saveFile << std::endl;
+  }
+
+  if(baselineFile.empty()) {
+    return 0;
+  }
+  std::map<std::string, double> baseline;
+  if(!readBaseline(baselineFile, baseline)) {
+    std::cerr << "Could not read " << baselineFile << std::endl;
+    return 1;
+  }
+  // times under MIN_COMPARE_MS are mostly noise - only compare larger ones
+  const double MIN_COMPARE_MS = 0.5;
+  int regressions = 0, compared = 0;
+  for(auto r = results.begin(); r != results.end(); ++r) {
+    for(auto s = r->stageMs.begin(); s != r->stageMs.end(); ++s) {
+      auto base = baseline.find(r->config.name + "." + s->first);
+      if(base == baseline.end() || std::max(base->second, s->second) < MIN_COMPARE_MS) {
+        continue;
+      }
+      ++compared;
+      double change = (s->second - base->second) / base->second * 100;
+      if(change > tolerance) {
+        ++regressions;
+        std::cout << "REGRESSION " << r->config.name << " " << s->first << ": " << std::fixed
+                  << std::setprecision(3) << base->second << " ms -> " << s->second << " ms (+"
+                  << std::setprecision(1) << change << "%)" << std::endl;
+      }
+    }
+  }
+  std::cout << compared << " stage timings compared with " << baselineFile << ", " << regressions
+            << " regressions (tolerance " << tolerance << "%)" << std::endl;
+  return (regressions > 0) ? 2 : 0;
+}
+
+void printUsage() {
+  std::cout << "Usage ./course_guide_bench [--courses N] [--categories N] [--students N] [--pool N]"
+            << " [--iterations N] [--seed N]" << std::endl
+            << "       [--baseline FILE] [--tolerance PERCENT] [--save-baseline FILE] [--out FILE]" << std::endl;
+}
+
+/*
+ * Creates a catalog of every course from 100 to 999 in 26 listings (23400 courses)
+ * with made up names and 1 to 5 credits.
+ */
+std::vector<Course> makeCatalog(std::mt19937 &rng) {
+  static const char *listings[] = { "CS", "MATH", "STAT", "ECE", "PHYSICS", "CHEM", "BIOCHEM", "ECON",
+                                    "HISTORY", "ENGL", "PSYCH", "SOC", "GEOG", "ART", "MUSIC", "PHILOS",
+                                    "LING", "ASTRON", "BOTANY", "ZOOLOGY", "GEN BUS", "ACCT I S", "FINANCE",
+                                    "M E", "E C E", "L I S" };
+  std::vector<Course> catalog;
+  for(size_t l = 0; l < sizeof(listings) / sizeof(listings[0]); ++l) {
+    for(int num = 100; num < 1000; ++num) {
+      CourseKey key = CourseKey::make(listings[l], num);
+      catalog.push_back(Course(1 + rng() % 5, std::string(listings[l]) + " Course " + std::to_string(num), key));
+    }
+  }
+  return catalog;
+}
+
+/*
+ * Creates config.majors majors, each with 15 required courses and config.categories option
+ * categories of config.poolSize courses (Electives, the last, has four times as many).
+ */
+std::vector<MajorRequirements> makeMajors(std::mt19937 &rng, const BenchConfig &config,
+                                          const std::vector<Course> &catalog) {
+  std::vector<MajorRequirements> majors;
+  for(int m = 0; m < config.majors; ++m) {
+    MajorRequirements req;
+    req.id = m + 1;
+    req.major = "Major " + std::to_string(m + 1);
+    req.listing = catalog[(m * 900) % catalog.size()].getKey().getListing();
+    for(int i = 0; i < 15; ++i) {
+      req.required.push_back(catalog[rng() % catalog.size()]);
+    }
+    for(int c = 0; c < config.categories; ++c) {
+      bool electives = (c == config.categories - 1);
+      OptionCategory category(electives ? "Electives" : "Category " + std::to_string(c + 1), 1 + rng() % 4);
+      int size = electives ? config.poolSize * 4 : config.poolSize;
+      for(int i = 0; i < size; ++i) {
+        category.courses.push_back(catalog[rng() % catalog.size()]);
+      }
+      req.categories.push_back(category);
+    }
+    majors.push_back(req);
+  }
+  return majors;
+}
+
+/*
+ * Creates the transcripts of config.students students in the one student per line layout.
+ * Half of each student's courses come from the requirements of their major (so the matcher
+ * has work to do) and the rest from anywhere in the catalog.
+ */
+std::string makeTranscripts(std::mt19937 &rng, const BenchConfig &config,
+                            const std::vector<MajorRequirements> &majors, const std::vector<Course> &catalog) {
+  std::string text;
+  for(int s = 0; s < config.students; ++s) {
+    const MajorRequirements &req = majors[s % majors.size()];
+    std::vector<const Course *> majorCourses;
+    for(auto it = req.required.begin(); it != req.required.end(); ++it) {
+      majorCourses.push_back(&*it);
+    }
+    for(auto c = req.categories.begin(); c != req.categories.end(); ++c) {
+      for(auto it = c->courses.begin(); it != c->courses.end(); ++it) {
+        majorCourses.push_back(&*it);
+      }
+    }
+
+    std::unordered_set<CourseKey> taken;
+    std::string courses;
+    auto take = [&taken, &courses](const Course &c) {
+      if(!taken.insert(c.getKey()).second) {
+        return;// already taken
+      }
+      if(!courses.empty()) {
+        courses.push_back(',');
+      }
+      courses.append(c.getCourseNum());
+    };
+    int wanted = std::min<int>(config.courses, catalog.size());
+    std::shuffle(majorCourses.begin(), majorCourses.end(), rng);
+    for(auto it = majorCourses.begin(); it != majorCourses.end() && (int)taken.size() < wanted / 2; ++it) {
+      take(**it);
+    }
+    while((int)taken.size() < wanted) {
+      take(catalog[rng() % catalog.size()]);
+    }
+    text.append(std::to_string(9000000000LL + s) + "|" + std::to_string(1 + s % 4) + "|Student "
+                + std::to_string(s) + "|" + req.major + "|" + courses + "\n");
+  }
+  return text;
+}
+
+/*
+ * Times every stage of an audit of one synthetic data set. Each stage is run iterations
+ * times and the best time is kept (the least disturbed by other processes).
+ *   parse   read the transcripts into Students
+ *   load    open the catalog snapshot and read the requirements of every student's major
+ *   lookup  fill in the course data of every requirement from the CourseCatalog
+ *           (the cached path of populateCourseData)
+ *   match   compile the loaded requirements of each major into a RequirementProgram and
+ *           audit every student against it
+ *   report  write every audit as a text report
+ *   reaudit update every audit for a grade posting (three courses added, one removed)
+ *           with IncrementalAudit instead of auditing again
+ *   store   read the transcripts into a StudentStore instead of Students and walk every
+ *           student's courses
+ *   cached  audit every student again through an AuditCache that has seen every student
+ *           twice (each distinct transcript is audited once, the rest are hits)
+ */
+BenchResult runConfig(const BenchConfig &config, int iterations, unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::vector<Course> catalog = makeCatalog(rng);
+  std::vector<MajorRequirements> majors = makeMajors(rng, config, catalog);
+  std::string transcripts = makeTranscripts(rng, config, majors, catalog);
+
+  char snapshotPath[] = "/tmp/course_guide_bench_XXXXXX";
+  int fd = mkstemp(snapshotPath);
+  if(fd >= 0) {
+    close(fd);
+  }
+  std::string error;
+  if(fd < 0 || !CatalogSnapshot::write(snapshotPath, majors, std::map<CourseKey, std::vector<Course> >(), "bench", error)) {
+    std::cerr << "Could not write a snapshot for " << config.name << ": " << error << std::endl;
+    exit(1);
+  }
+  CourseCatalog::instance().warm(catalog);
+  // the compiled requirements and the index IncrementalAudit needs for each major (student s
+  // has major s % majors.size())
+  std::vector<std::shared_ptr<const RequirementProgram> > programs;
+  std::vector<std::shared_ptr<const RequirementIndex> > indexes;
+  for(auto it = majors.begin(); it != majors.end(); ++it) {
+    programs.push_back(std::make_shared<const RequirementProgram>(std::make_shared<const MajorRequirements>(*it)));
+    indexes.push_back(std::shared_ptr<const RequirementIndex>(new RequirementIndex(programs.back())));
+  }
+
+  std::map<std::string, std::vector<double> > times;
+  auto timeStage = [&times](const std::string &stage, std::function<void()> run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    times[stage].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  };
+
+  size_t checksum = 0;// keeps the work from being optimized away
+  for(int i = 0; i < iterations; ++i) {
+    std::vector<Student> students;
+    std::vector<MajorRequirements> reqs(config.students);
+    std::vector<AuditResult> results;
+
+    timeStage("parse", [&]() {
+      TranscriptParser parser(transcripts.data(), transcripts.size(), "synthetic");
+      parser.parse([&students](const TranscriptRecord &record) {
+        students.push_back(Student(record));
+      });
+    });
+    timeStage("load", [&]() {
+      CatalogSnapshot snapshot;
+      std::string error;
+      if(!snapshot.open(snapshotPath, error)) {
+        std::cerr << error << std::endl;
+        exit(1);
+      }
+      for(size_t s = 0; s < students.size(); ++s) {
+        snapshot.getRequirements(students[s].getMajor(), reqs[s]);
+      }
+    });
+    timeStage("lookup", [&]() {
+      CourseCatalog &cache = CourseCatalog::instance();
+      for(auto req = reqs.begin(); req != reqs.end(); ++req) {
+        for(auto it = req->required.begin(); it != req->required.end(); ++it) {
+          checksum += cache.lookup(*it);
+        }
+        for(auto c = req->categories.begin(); c != req->categories.end(); ++c) {
+          for(auto it = c->courses.begin(); it != c->courses.end(); ++it) {
+            checksum += cache.lookup(*it);
+          }
+        }
+      }
+    });
+    timeStage("match", [&]() {
+      std::map<std::string, std::shared_ptr<const RequirementProgram> > compiled;
+      for(size_t s = 0; s < students.size(); ++s) {
+        std::shared_ptr<const RequirementProgram> &program = compiled[reqs[s].major];
+        if(!program) {
+          program = std::make_shared<const RequirementProgram>(std::make_shared<const MajorRequirements>(reqs[s]));
+        }
+        results.push_back(students[s].audit(*program));
+      }
+    });
+    timeStage("report", [&]() {
+      std::ostringstream report;
+      {
+        ReportWriter writer(report, REPORT_TEXT);
+        for(auto it = results.begin(); it != results.end(); ++it) {
+          writer.write(*it);
+        }
+      }
+      checksum += report.str().size();
+    });
+
+    // keep every audit and make up the grade posting of every student
+    std::vector<std::unique_ptr<IncrementalAudit> > kept;
+    std::vector<std::vector<CourseKey> > added(students.size()), removed(students.size());
+    for(size_t s = 0; s < students.size(); ++s) {
+      kept.push_back(std::unique_ptr<IncrementalAudit>(new IncrementalAudit(students[s], indexes[s % majors.size()])));
+      for(int c = 0; c < 3; ++c) {
+        added[s].push_back(catalog[rng() % catalog.size()].getKey());
+      }
+      const std::vector<CourseKey> &completed = students[s].getCompletedKeys();
+      if(!completed.empty()) {
+        removed[s].push_back(completed[rng() % completed.size()]);
+      }
+    }
+    timeStage("reaudit", [&]() {
+      for(size_t s = 0; s < kept.size(); ++s) {
+        checksum += kept[s]->apply(added[s], removed[s]);
+      }
+    });
+    timeStage("store", [&]() {
+      StudentStore store;
+      TranscriptParser parser(transcripts.data(), transcripts.size(), "synthetic");
+      parser.parse([&store](const TranscriptRecord &record) {
+        store.add(record);
+      });
+      for(size_t s = 0; s < store.size(); ++s) {
+        CourseSpan completed = store[s].getCompleted();
+        for(auto it = completed.begin(); it != completed.end(); ++it) {
+          checksum += (*it).getNumber();
+        }
+      }
+    });
+    AuditCache audits;
+    for(int pass = 0; pass < 2; ++pass) {
+      for(size_t s = 0; s < students.size(); ++s) {
+        audits.audit(programs[s % programs.size()], students[s].newResult());
+      }
+    }
+    timeStage("cached", [&]() {
+      for(size_t s = 0; s < students.size(); ++s) {
+        checksum += audits.audit(programs[s % programs.size()], students[s].newResult()).getCategories().size();
+      }
+    });
+  }
+  unlink(snapshotPath);
+
+  BenchResult result;
+  result.config = config;
+  for(auto it = times.begin(); it != times.end(); ++it) {
+    result.stageMs[it->first] = *std::min_element(it->second.begin(), it->second.end());
+  }
+  if(checksum == 0) {
+    std::cerr << "Nothing was audited for " << config.name << std::endl;
+  }
+  return result;
+}
+
+void printResults(const std::vector<BenchResult> &results, std::ostream &out) {
+  std::streamsize precision = out.precision();
+  out << std::left << std::setw(14) << "config" << std::right << std::setw(9) << "students";
+  for(size_t s = 0; s < sizeof(STAGES) / sizeof(STAGES[0]); ++s) {
+    out << std::setw(12) << (std::string(STAGES[s]) + " ms");
+  }
+  out << std::setw(14) << "us/student" << std::endl;
+  for(auto r = results.begin(); r != results.end(); ++r) {
+    double total = 0;
+    out << std::left << std::setw(14) << r->config.name << std::right << std::setw(9) << r->config.students
+        << std::fixed << std::setprecision(3);
+    for(size_t s = 0; s < sizeof(STAGES) / sizeof(STAGES[0]); ++s) {
+      double ms = r->stageMs.at(STAGES[s]);
+      if(std::find(std::begin(REDO_STAGES), std::end(REDO_STAGES), std::string(STAGES[s])) == std::end(REDO_STAGES)) {
+        total += ms;
+      }
+      out << std::setw(12) << ms;
+    }
+    out << std::setw(14) << std::setprecision(1) << total * 1000 / r->config.students << std::endl;
+  }
+  out << std::defaultfloat << std::setprecision(precision);
+}
+
+/*
+ * Reads a baseline saved with --save-baseline: one "<config>.<stage> <best ms>" per line.
+ */
+bool readBaseline(const std::string &path, std::map<std::string, double> &baseline) {
+  std::ifstream in(path);
+  if(!in) {
+    return false;
+  }
+  std::string line;
+  while(getline(in, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    double ms;
+    if(line.empty() || line[0] == '#' || !(fields >> key >> ms)) {
+      continue;
+    }
+    baseline[key] = ms;
+  }
+  return true;
+}
+
+bool writeBaseline(const std::string &path, const std::vector<BenchResult> &results) {
+  std::ofstream out(path);
+  out << "# course_guide_bench baseline: <config>.<stage> <best ms>" << std::endl;
+  out << std::fixed << std::setprecision(4);
+  for(auto r = results.begin(); r != results.end(); ++r) {
+    for(size_t s = 0; s < sizeof(STAGES) / sizeof(STAGES[0]); ++s) {
+      out << r->config.name << "." << STAGES[s] << " " << r->stageMs.at(STAGES[s]) << std::endl;
+    }
+  }
+  return (bool)out;
+}
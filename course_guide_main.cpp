@@ -10,11 +10,35 @@
 //                 prints which requirements have been completed and which
 // 		   classes need to be taken or gives class options if there
 // 		   is a choice. Accepts the student data as a command line
-//		   argument containing a txt file name.
+//		   argument containing a txt file name (which may hold many
+//		   students). In --batch mode many student files are audited
+//		   at once by a pool of threads. With --snapshot the
+//		   requirements are read from a catalog snapshot (made with
+//		   --export-snapshot) and with --fixture from a fixture file
+//		   (see InMemoryCatalogSource) instead of the database. With --serve
+//		   it runs as a server answering audit requests on a Unix
+//		   domain socket with warm caches. --stats prints a summary
+//		   of the counters and stage timers (see Metrics.hpp) and
+//		   --metrics writes them in the Prometheus format. --plan adds
+//		   a semester by semester plan to finish the major to every
+//		   report (see GraduationPlanner.hpp) and --eligible the courses
+//		   that can be taken next semester (see Prerequisites.hpp).
+//		   --elective-limit shows the Electives choices a page at a time
+//		   and reads the data of only those courses (see
+//		   ChoicePager.hpp). A student whose major field lists several
+//		   majors separated by ';' is audited against each of them, with
+//		   --max-shared and --exclusive limiting the courses that count
+//		   for more than one (see MultiMajorAudit.hpp). --demand audits
+//		   a whole cohort and prints how many students still need each
+//		   course (see CourseDemand.hpp). Students who have taken the
+//		   same courses for a major share one audit (see AuditCache.hpp,
+//		   sized with --audit-cache MB). The database
+//		   to use is read from --db-config or the environment (see
+//		   ConnectionPool.hpp).
 ///////////////////////////////////////////////////////////////////////////////
 
 // Note: Must use the following tags to compile:
-//       -lmysqlcppconn -lmysqlcppconn-static
+//       -std=c++17 -lmysqlcppconn -lmysqlcppconn-static -pthread
 
 // include standard c++ libs
 #include <memory>
@@ -22,11 +46,43 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cctype>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+// include posix headers for reading directories
+#include <sys/stat.h>
+#include <dirent.h>
 // include custom classes
 #include "Student.hpp"
 #include "Course.hpp"
+#include "CourseKey.hpp"
+#include "CourseCatalog.hpp"
+#include "MajorRequirements.hpp"
+#include "CatalogSnapshot.hpp"
+#include "TranscriptParser.hpp"
+#include "AuditResult.hpp"
+#include "ReportWriter.hpp"
+#include "CatalogSource.hpp"
+#include "MySqlCatalogSource.hpp"
+#include "InMemoryCatalogSource.hpp"
+#include "SnapshotCatalogSource.hpp"
+#include "RequirementsCache.hpp"
+#include "AuditCache.hpp"
+#include "AuditServer.hpp"
+#include "Metrics.hpp"
+#include "IncrementalAudit.hpp"
+#include "GraduationPlanner.hpp"
+#include "ChoicePager.hpp"
+#include "MultiMajorAudit.hpp"
+#include "CourseDemand.hpp"
+#include "StudentStore.hpp"
 
 // include mysql/c++ connector headers
 #include "mysql_connection.h"
@@ -37,294 +93,1083 @@
 #include <cppconn/statement.h>
 #include <cppconn/prepared_statement.h>
 
-// define database info
-#define DB "course_guide_system"
-
 // define funcitons
-void printCourses(std::vector<Course> courses);
+void printUsage();
+std::unique_ptr<CatalogSource> openCatalogSource(const std::string &snapshotFile, const std::string &fixtureFile,
+                                                 const std::string &dbConfig, unsigned int workers);
+int runBatch(int argc, char* argv[]);
+int runExport(int argc, char* argv[]);
+int runServer(int argc, char* argv[]);
+int runDemand(int argc, char* argv[]);
+std::string answerRequest(const std::string &request, ReportFormat format, RequirementsCache &cache,
+                          CatalogSource &source, const MultiMajorAudit &multiMajor, AuditCache &auditCache,
+                          AuditStore &store);
+std::string answerDelta(const std::string &request, size_t begin, ReportFormat format, AuditStore &store);
+std::shared_ptr<const RequirementProgram> findProgram(const std::string &major, RequirementsCache &cache,
+                                                      CatalogSource &source);
+std::vector<AuditResult> auditMajors(const Student &student, const std::vector<std::string> &majors,
+                                     const std::vector<std::shared_ptr<const RequirementProgram> > &programs,
+                                     const MultiMajorAudit &multiMajor, AuditCache &auditCache);
+bool collectStudentFiles(const std::string &arg, std::vector<std::string> &files);
+std::string reportPath(const std::string &outDir, const std::string &file, const std::string &extension);
+bool readStudents(const std::string &path, std::vector<Student> &students);
+bool writeMetrics(const std::string &metricsFile);
+void printCourses(std::vector<Course> courses, std::ostream &out = std::cout);
 void printStringVector(const std::vector<std::string> print_me);
 std::vector<std::string> concatCourseNumsAndListings(std::vector<std::string> results);
-std::vector<Course> createCourses(std::vector<std::string> listings, std::vector<std::string> nums);
-void populateCourseData(std::vector<Course> &courses, std::unique_ptr<sql::Connection> &con);
-void updateRequired(std::vector<Course> &required, std::vector<Course> &completed);
 
 int main(int argc, char* argv[]) {
-  // connect to the datatbase (course_guide_system)
-  sql::Driver *driver;
-  std::unique_ptr< sql::Connection > con;
-  try {
-    driver = get_driver_instance();
-    con.reset(driver->
-       connect("tcp://127.0.0.1:3306", "root", "2yzlzhb2"));
-  }
-  catch(sql::SQLException &e) {
-    // connection could not be estabolished
-    std::cout << "# ERR: SQLException in " << __FILE__;
-    std::cout << "(" << __FUNCTION__ << ") on line " << __LINE__ << std::endl;
-    /* what() (derived from std::runtime_error) fetches error message */
-    std::cout << "# ERR: " << e.what();
-    std::cout << " (MySQL error code: " << e.getErrorCode();
-    std::cout << ", SQLState: " << e.getSQLState() << " )" << std::endl;
-  }
-  con->setSchema(DB);// open course_guide_system database
-
-  // create student object from text file
-  // the list of passed courses will be made into course objects and stored within s
-  Student s;
-  if(argc > 1) {
-    s = Student(argv[1]);
-  } else {
+  if(argc < 2) {
     // no student data inputted
-    std::cout << "Please input a student txt file" << std::endl << "Usage ./course_guide <Student.txt>" << std::endl;
+    printUsage();
     return 1;
   }
-  s.printStudentData();  
-  std::cout << std::endl; 
-  // find the student's major id from the name of the major
-  // use a prepared statement to call the stored procedure
-  std::unique_ptr< sql::PreparedStatement > p_stmt(con->
-      prepareStatement("CALL get_major_id(?, @m_id)"));
-  std::unique_ptr< sql::ResultSet > res;
-  std::unique_ptr< sql::Statement > stmt(con->createStatement());  
-  int major_id;
-
-  p_stmt->setString(1, s.getMajor());
-  p_stmt->execute();
-  
-  res.reset(stmt->executeQuery("SELECT @m_id"));
-
-  if(res->next()) {
-    major_id = res->getInt("@m_id");
-  }
-
-  // find the courses for this major absolutely required to graduate
-  // intialize a vector to hold these courses
-  std::vector<Course> requiredCourses;
-  std::vector<std::string> results;// holds database results
-  // use the get_abs_req_courses preocedure to get info from database
-  // appends are used to construct the query statment which parameters
-  std::string caller("CALL get_abs_req_courses(");
-  caller.append(std::to_string(major_id));
-  caller.append(")");
-  stmt->execute(caller);
-
-  // This statement will return the data from each column as 1 big list
-  // the first half of the result set will be the course nums and second half is the listing
-  do {
-    res.reset(stmt->getResultSet());
-    // get the course nums and the course listings
-    while(res->next()) {
-      std::string result = res->getString(1);
-      results.push_back(result);
-    }
-  } while(stmt->getMoreResults());
-  
-  // results contains the first half course nums and second half course listings
-  // concat the listing and course num to form an unique course id ( "CS" + 368 ->"CS368")
-  // use this id to create a Course object for each course
-  auto it_listing = results.begin() + results.size() / 2;
-  for(auto it_num = results.begin(); it_num != (results.end() - results.size() / 2); ++it_num) {
-    std::string concat = *it_listing;
-    concat.append(*it_num);
-    requiredCourses.push_back(Course(concat));
-    ++it_listing;
-  }
-
-  // populate the required courses with the rest of the course data (credits, full name, and prereqs)
-  populateCourseData(requiredCourses, con);
-  // remove all courses from the required list which have already been completed
-  std::vector<Course> completedCourses = s.getCompleted();
-  updateRequired(requiredCourses, completedCourses);
-  // print the required courses that still need to be taken
-  std::cout << "Required Courses for " << s.getMajor() << ":" <<  std::endl;
-  printCourses(requiredCourses);
-  std::cout << std::endl;
-
-  // get the elective classes with options
-  std::map<std::string, int> optionClasses;
-  caller.clear();
-  caller = std::string("CALL getMajorOptions(");
-  caller.append(std::to_string(major_id));
-  caller.append(")");
-  stmt->execute(caller);
-  do {
-    res.reset(stmt->getResultSet());
-    // get option_class name and number of classes which need to be taken to fulfill the req
-    while(res->next()) {
-      std::string result = res->getString(1);
-      optionClasses.insert(std::pair<std::string, int>(result, res->getInt(2)));
-    }
-  } while(stmt->getMoreResults());
-   
-  // if there is an electives options class - out it at the rear of vector
-  // this is so courses are not used to fulfill electives beore the other reqs
-  std::pair<std::string, int> electives;
-  auto elective_ptr = optionClasses.find("Electives"); 
-  bool hasElectives = false;
-  if(elective_ptr != optionClasses.end()) {
-    hasElectives = true;
-    std::string n = elective_ptr->first;
-    int a = elective_ptr->second;
-    optionClasses.erase(elective_ptr);
-    electives = std::pair<std::string, int>(n, a);
-  }
-  
-  // iterate over the elective options classes and determine if they have been fulfilled
-  for(auto it = optionClasses.begin(); it != optionClasses.end(); ++it) {
-    // if the user has not fulfilled an option - present them with a list of choices
-    std::vector<std::string> o_courseNums;
-    std::vector<std::string> o_listings;
-    std::vector<Course> o_courses;// create from the info in the above vectors
-    // get the course info for this class from the database
-    std::string caller("CALL getOptionalElectives('");
-    caller.append(it->first);
-    caller.append("', ");
-    caller.append(std::to_string(major_id));
-    caller.append(")");
-    stmt->execute(caller);
-  
-    // get the results  
-    do {
-      res.reset(stmt->getResultSet());
-      // get the course nums and the course listings
-      while(res->next()) {
-        std::string result = res->getString(1);
-        o_courseNums.push_back(result);
-        result = res->getString(2);
-        o_listings.push_back(result);
+  if(std::string(argv[1]) == "--batch") {
+    return runBatch(argc, argv);
+  }
+  if(std::string(argv[1]) == "--export-snapshot") {
+    return runExport(argc, argv);
+  }
+  if(std::string(argv[1]) == "--serve") {
+    return runServer(argc, argv);
+  }
+  if(std::string(argv[1]) == "--demand") {
+    return runDemand(argc, argv);
+  }
+
+  std::string studentFile, snapshotFile, fixtureFile, dbConfig, metricsFile;
+  bool printStats = false, makePlans = false, listEligible = false;
+  int creditCap = GraduationPlanner::DEFAULT_CREDIT_CAP;
+  int electiveLimit = 0, electivePage = 0;
+  ChoiceOrder electiveOrder = CHOICES_LISTED;
+  OverlapRules overlap;
+  size_t auditCacheSize = AuditCache::DEFAULT_MAX_BYTES;
+  ReportFormat format = REPORT_TEXT;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--stats") {
+      printStats = true;
+    } else if(arg == "--max-shared" && i + 1 < argc) {
+      overlap.maxShared = atoi(argv[++i]);
+    } else if(arg == "--exclusive" && i + 1 < argc) {
+      overlap.exclusive.insert(argv[++i]);
+    } else if(arg == "--audit-cache" && i + 1 < argc) {
+      auditCacheSize = (size_t)std::max(0, atoi(argv[++i])) << 20;
+    } else if(arg == "--elective-limit" && i + 1 < argc) {
+      electiveLimit = std::max(0, atoi(argv[++i]));
+    } else if(arg == "--elective-page" && i + 1 < argc) {
+      electivePage = std::max(0, atoi(argv[++i]));
+    } else if(arg == "--elective-order" && i + 1 < argc) {
+      if(!ChoicePager::parseOrder(argv[++i], electiveOrder)) {
+        printUsage();
+        return 1;
       }
-    } while(stmt->getMoreResults());
- 
-    o_courses = createCourses(o_listings, o_courseNums); 
-    populateCourseData(o_courses, con);
-    s.isFulfilled(it->first, o_courses, it->second);
-    std::cout << std::endl;
-  }
-
-  // if a unique electives class exists - get the elective requriements
-  if(hasElectives) {
-    std::vector<std::string> o_courseNums;
-    std::vector<std::string> o_listings;
-    std::vector<Course> o_courses;// create from the info in the above vectors
-    // any class above 400 counts as an elective
-    // get the listing of this major
-    std::string caller("CALL getListing(");
-    caller.append(std::to_string(major_id));
-    caller.append(", @lst)");
-    stmt->execute(caller);
-    res.reset(stmt->executeQuery("SELECT @lst"));
-    std::string listing;
-    if(res->next()) {
-      listing = res->getString("@lst");
-    }
-    // call getElectives on this major listing
-    caller.clear();
-    caller = "CALL getElectives('";
-    caller.append(listing);
-    caller.append("')");
-    stmt->execute(caller);
-    // get the results  
-    do {
-      res.reset(stmt->getResultSet());
-      // get the course nums and the course listings
-      while(res->next()) {
-        std::string result = res->getString(1);
-        o_courseNums.push_back(result);
-        result = res->getString(2);
-        o_listings.push_back(result);
+    } else if(arg == "--plan") {
+      makePlans = true;
+    } else if(arg == "--eligible") {
+      listEligible = true;
+    } else if(arg == "--credit-cap" && i + 1 < argc) {
+      makePlans = true;
+      creditCap = atoi(argv[++i]);
+    } else if(arg == "--metrics" && i + 1 < argc) {
+      metricsFile = argv[++i];
+    } else if(arg == "--format" && i + 1 < argc) {
+      if(!ReportWriter::parseFormat(argv[++i], format)) {
+        printUsage();
+        return 1;
       }
-    } while(stmt->getMoreResults());
-    
-    o_courses = createCourses(o_listings, o_courseNums); 
-    populateCourseData(o_courses, con);   
-    s.isFulfilled(electives.first, o_courses, electives.second);
-  }  
+    } else if(arg == "--snapshot" && i + 1 < argc) {
+      snapshotFile = argv[++i];
+    } else if(arg == "--fixture" && i + 1 < argc) {
+      fixtureFile = argv[++i];
+    } else if(arg == "--db-config" && i + 1 < argc) {
+      dbConfig = argv[++i];
+    } else {
+      studentFile = arg;
+    }
+  }
+  if(studentFile.empty()) {
+    printUsage();
+    return 1;
+  }
+  Metrics::enable(printStats || !metricsFile.empty());
+
+  // create a student object for every student in the text file
+  // the list of passed courses will be made into course objects and stored within each student
+  std::vector<Student> students;
+  if(!readStudents(studentFile, students)) {
+    return 1;
+  }
+  CourseCatalog &catalog = CourseCatalog::instance();
+  RequirementsCache requirements;
+  std::unique_ptr<CatalogSource> source = openCatalogSource(snapshotFile, fixtureFile, dbConfig, 1);
+  if(!source) {
+    return 1;
+  }
+  // plans and eligible courses use the data of every choice
+  ChoicePager pager(electiveLimit, electiveOrder, electivePage);
+  source->setLazyElectives(pager.allowsLazyPools() && !makePlans && !listEligible);
+  if((makePlans || listEligible) && !source->providesPrerequisites()) {
+    std::cerr << "The catalog does not record prerequisites - --plan and --eligible need them" << std::endl;
+    return 1;
+  }
+
+  int status = 0;
+  MultiMajorAudit multiMajor(overlap);
+  AuditCache auditCache(auditCacheSize);
+  GraduationPlanner planner(creditCap);
+  PrerequisiteCache prerequisites;
+  ReportWriter writer(std::cout, format);
+  for(auto it = students.begin(); it != students.end(); ++it) {
+    // students of the same major share one load of the requirements
+    std::vector<std::string> majors = (*it).getMajors();
+    std::vector<AuditResult> results;
+    try {
+      std::vector<std::shared_ptr<const RequirementProgram> > programs;
+      for(auto m = majors.begin(); m != majors.end(); ++m) {
+        programs.push_back(findProgram(*m, requirements, *source));
+      }
+      results = auditMajors(*it, majors, programs, multiMajor, auditCache);
+      for(size_t i = 0; i < results.size(); ++i) {
+        AuditResult &result = results[i];
+        if(!result.majorFound) {
+          status = 1;
+          continue;
+        }
+        const std::shared_ptr<const MajorRequirements> &req = programs[i]->getRequirements();
+        if(listEligible) {
+          result.eligible = prerequisites.getIndex(*source, req)->eligibleCourses(result);
+          result.eligibleListed = true;
+        }
+        if(makePlans) {
+          result.plan = planner.plan(result, *prerequisites.get(*source, req));
+        }
+        pager.apply(result, *req, *source);
+      }
+    }
+    catch(std::runtime_error &e) {
+      writer.flush();
+      std::cerr << "# ERR: " << e.what() << std::endl;
+      return 1;
+    }
+    for(auto r = results.begin(); r != results.end(); ++r) {
+      writer.write(*r);
+    }
+  }
+  writer.flush();
+
+  if(printStats) {
+    catalog.printStats(std::cerr);
+    requirements.printStats(std::cerr);
+    auditCache.printStats(std::cerr);
+    source->printStats(std::cerr);
+    Metrics::instance().printSummary(std::cerr);
+  }
+  if(!writeMetrics(metricsFile)) {
+    return 1;
+  }
+  return status;
+}
 
+/*
+ * Reads every student in a transcript file (see TranscriptParser for the accepted layouts).
+ * Prints the problem and returns false if the file can not be read or is malformed.
+ */
+bool readStudents(const std::string &path, std::vector<Student> &students) {
+  static Histogram &parseTime = Metrics::stage("parse");
+  ScopedTimer timer(parseTime);
+  try {
+    TranscriptParser::parseFile(path, [&students](const TranscriptRecord &record) {
+      students.push_back(Student(record));
+    });
+  }
+  catch(TranscriptError &e) {
+    std::cerr << "# ERR: " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Writes every metric to metricsFile in the Prometheus text format (nothing if it is empty).
+ * Prints the problem and returns false if the file could not be written.
+ */
+bool writeMetrics(const std::string &metricsFile) {
+  std::string error;
+  if(!metricsFile.empty() && !Metrics::instance().writePrometheus(metricsFile, error)) {
+    std::cerr << "# ERR: " << error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void printUsage() {
+  std::cout << "Please input a student txt file" << std::endl
+            << "Usage ./course_guide [--snapshot FILE | --fixture FILE | --db-config FILE]"
+            << " [--format text|json|csv] [--plan] [--eligible] [--credit-cap N]"
+            << " [--elective-limit N] [--elective-order listed|number|credits] [--elective-page N]"
+            << " [--max-shared N] [--exclusive CATEGORY] [--audit-cache MB] [--stats]"
+            << " [--metrics FILE] <Student.txt>"
+            << std::endl
+            << "      ./course_guide --batch [--threads N] [--out DIR]"
+            << " [--snapshot FILE | --fixture FILE | --db-config FILE] [--format text|json|csv] [--plan]"
+            << " [--eligible] [--credit-cap N] [--elective-limit N] [--elective-order listed|number|credits]"
+            << " [--elective-page N] [--max-shared N] [--exclusive CATEGORY] [--audit-cache MB] [--stats] [--metrics FILE]"
+            << " <directory | @manifest | Student.txt ...>" << std::endl
+            << "      ./course_guide --export-snapshot FILE [--fixture FILE | --db-config FILE]"
+            << " <major | @majors file ...>" << std::endl
+            << "      ./course_guide --serve SOCKET [--workers N] [--queue N] [--max-shared N] [--exclusive CATEGORY]"
+            << " [--audit-cache MB] [--audit-store N]"
+            << " [--snapshot FILE | --fixture FILE | --db-config FILE] [--format text|json|csv] [--stats]"
+            << " [--metrics FILE]" << std::endl
+            << "      ./course_guide --demand [--threads N] [--max-shared N] [--exclusive CATEGORY]"
+            << " [--snapshot FILE | --fixture FILE | --db-config FILE] [--format text|json|csv] [--stats]"
+            << " [--metrics FILE] <directory | @manifest | Student.txt ...>" << std::endl;
+}
+
+/*
+ * Exports the requirements of the majors named on the command line, with the data of
+ * every course they reference, to a catalog snapshot file (--export-snapshot mode).
+ * They are read from the database, or from a fixture file with --fixture.
+ * A name starting with @ is a file listing one major per line. At least one major must be
+ * named - an empty snapshot is never written.
+ */
+int runExport(int argc, char* argv[]) {
+  if(argc < 4) {
+    printUsage();
+    return 1;
+  }
+  std::string snapshotFile(argv[2]), fixtureFile, dbConfig;
+  std::vector<std::string> majors;
+  for(int i = 3; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--db-config" && i + 1 < argc) {
+      dbConfig = argv[++i];
+      continue;
+    }
+    if(arg == "--fixture" && i + 1 < argc) {
+      fixtureFile = argv[++i];
+      continue;
+    }
+    if(arg[0] != '@') {
+      majors.push_back(arg);
+      continue;
+    }
+    std::ifstream majorFile(arg.substr(1));
+    if(!majorFile) {
+      std::cerr << "Could not open " << arg.substr(1) << std::endl;
+      return 1;
+    }
+    std::string line;
+    while(getline(majorFile, line)) {
+      if(!line.empty()) {
+        majors.push_back(line);
+      }
+    }
+  }
+  if(majors.empty()) {
+    std::cerr << "No majors to export - name them or list them in an @majors file" << std::endl;
+    printUsage();
+    return 1;
+  }
+
+  std::unique_ptr<CatalogSource> source = openCatalogSource("", fixtureFile, dbConfig, 1);
+  if(!source) {
+    return 1;
+  }
+  std::vector<MajorRequirements> loaded;
+  for(auto it = majors.begin(); it != majors.end(); ++it) {
+    MajorRequirements req;
+    if(!source->loadRequirements(*it, req)) {
+      std::cerr << "The major " << *it << " could not be found." << std::endl;
+      return 1;
+    }
+    loaded.push_back(req);
+  }
+  // the prerequisites of every course the majors use and, in turn, of those prerequisites
+  std::map<CourseKey, std::vector<Course> > prerequisites;
+  for(auto it = loaded.begin(); it != loaded.end(); ++it) {
+    std::shared_ptr<const PrerequisiteGraph> graph = PrerequisiteGraph::load(*source, *it);
+    for(auto p = graph->prerequisites.begin(); p != graph->prerequisites.end(); ++p) {
+      std::vector<Course> &list = prerequisites[p->first];
+      list.clear();
+      for(auto key = p->second.begin(); key != p->second.end(); ++key) {
+        list.push_back(graph->courses.at(*key));
+      }
+    }
+  }
+  std::string error;
+  if(!CatalogSnapshot::write(snapshotFile, loaded, prerequisites, source->getCatalogVersion(), error)) {
+    std::cerr << "# ERR: " << error << std::endl;
+    return 1;
+  }
+  std::cerr << "Exported " << loaded.size() << " majors to " << snapshotFile << std::endl;
   return 0;
 }
 
-// prints a vector of strings to cout
-void printStringVector(const std::vector<std::string> print_me) {
-  for(auto it = print_me.begin(); it != print_me.end(); ++it) {
-    std::cout << *it << std::endl;
+/*
+ * Opens the catalog the requirements are read from: the snapshot if snapshotFile is given,
+ * the fixture if fixtureFile is given and otherwise the course_guide_system database (see
+ * MySqlCatalogSource::create), with a pool of connections for workers threads.
+ * Course data cached under another catalog version is dropped.
+ * Prints the problem and returns an empty pointer if the catalog can not be opened.
+ */
+std::unique_ptr<CatalogSource> openCatalogSource(const std::string &snapshotFile, const std::string &fixtureFile,
+                                                 const std::string &dbConfig, unsigned int workers) {
+  std::unique_ptr<CatalogSource> source;
+  std::string error;
+  if(!snapshotFile.empty()) {
+    // read the requirements from the snapshot - no database needed
+    std::unique_ptr<SnapshotCatalogSource> snapshot(new SnapshotCatalogSource());
+    if(snapshot->open(snapshotFile, error)) {
+      source = std::move(snapshot);
+    }
+  } else if(!fixtureFile.empty()) {
+    // hold the whole catalog in memory - no database needed
+    std::unique_ptr<InMemoryCatalogSource> fixture(new InMemoryCatalogSource());
+    if(fixture->load(fixtureFile, error)) {
+      source = std::move(fixture);
+    }
+  } else {
+    // connect to the datatbase (course_guide_system)
+    // and stop before any work is done if it can not be reached
+    std::unique_ptr<MySqlCatalogSource> db = MySqlCatalogSource::create(dbConfig, workers, error);
+    if(db && db->check(error)) {
+      source = std::move(db);
+    }
   }
+  if(!source) {
+    std::cerr << "# ERR: " << error << std::endl;
+    return source;
+  }
+  CourseCatalog::instance().checkVersion(source->getCatalogVersion());
+  return source;
 }
 
-// prints the data of each course in the vector
-void printCourses(std::vector<Course> courses) {
-  for(auto it = courses.begin(); it != courses.end(); ++it) {
-    std::cout << "-";
-    (*it).printData();
+/*
+ * Gets the compiled requirements of a major through the requirements cache, loading them
+ * from the catalog source on a miss.
+ * Returns a null pointer if the major does not exist.
+ * Throws sql::SQLException if loading fails and std::runtime_error if no connection can be made.
+ */
+std::shared_ptr<const RequirementProgram> findProgram(const std::string &major, RequirementsCache &cache,
+                                                      CatalogSource &source) {
+  static Histogram &requirementsTime = Metrics::stage("requirements");
+  ScopedTimer timer(requirementsTime);
+  return cache.getProgram(major, [&source](const std::string &name, MajorRequirements &req) {
+    return source.loadRequirements(name, req);
+  });
+}
+
+/*
+ * Audits a student against their majors (programs[i] holds the requirements of majors[i],
+ * null if that major does not exist). A student with one major is audited on its own
+ * through the audit cache and one with several through the MultiMajorAudit, which decides
+ * the courses they share.
+ * Returns one result per major.
+ */
+std::vector<AuditResult> auditMajors(const Student &student, const std::vector<std::string> &majors,
+                                     const std::vector<std::shared_ptr<const RequirementProgram> > &programs,
+                                     const MultiMajorAudit &multiMajor, AuditCache &auditCache) {
+  if(majors.size() > 1) {
+    return multiMajor.audit(student.newResult(), majors, programs);
   }
+  if(!programs[0]) {
+    return std::vector<AuditResult>(1, student.newResult());
+  }
+  return std::vector<AuditResult>(1, auditCache.audit(programs[0], student.newResult()));
 }
 
-/* Creates a vector of Courses from vectors of course numbers and listings
- * concatinates the class listing and course num into a string of the form "CS302"
+/*
+ * Adds the student files named by a batch argument to files.
+ * A directory adds every regular file inside it, "@manifest" adds every path listed
+ * in the manifest (one per line) and anything else is taken as a student file.
+ * Returns false if the argument does not name anything that can be read.
  */
-std::vector<Course> createCourses(std::vector<std::string> listings, std::vector<std::string> nums) {
-  std::vector<Course> courses;
-  auto it_listing = listings.begin();
-  // halt once the course_num iterator is half way through the list as this is where the listings begin
-  for(auto it_num = nums.begin(); it_num != nums.end(); ++it_num) {
-    std::string concat = *it_listing;
-    concat.append(*it_num);
-    courses.push_back(Course(concat));
-    ++it_listing;
-  }
-  return courses;
+bool collectStudentFiles(const std::string &arg, std::vector<std::string> &files) {
+  if(!arg.empty() && arg[0] == '@') {
+    std::ifstream manifest(arg.substr(1));
+    if(!manifest) {
+      std::cerr << "Could not open manifest " << arg.substr(1) << std::endl;
+      return false;
+    }
+    std::string line;
+    while(getline(manifest, line)) {
+      if(!line.empty()) {
+        files.push_back(line);
+      }
+    }
+    return true;
+  }
+
+  struct stat info;
+  if(stat(arg.c_str(), &info) != 0) {
+    std::cerr << "Could not find " << arg << std::endl;
+    return false;
+  }
+  if(!S_ISDIR(info.st_mode)) {
+    files.push_back(arg);
+    return true;
+  }
+  DIR *dir = opendir(arg.c_str());
+  if(dir == NULL) {
+    std::cerr << "Could not open directory " << arg << std::endl;
+    return false;
+  }
+  for(struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+    std::string path = arg + "/" + entry->d_name;
+    if(stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+      files.push_back(path);
+    }
+  }
+  closedir(dir);
+  return true;
 }
 
+// the report of a student file is written to <outDir>/<file name><extension>
+std::string reportPath(const std::string &outDir, const std::string &file, const std::string &extension) {
+  std::string::size_type slash = file.find_last_of('/');
+  std::string name = (slash == std::string::npos) ? file : file.substr(slash + 1);
+  return outDir + "/" + name + extension;
+}
+
+// a student to audit in --batch mode and the file their report goes to
+struct BatchJob {
+  Student student;
+  std::string report;
+};
+
 /*
- * Takes in a list of course objects with only the courseNum field non-null
- * Communicates with the database to get the number of credits, prereqs, and full name
- * and adds this info to the ocurse list.
+ * Audits every student file given on the command line (--batch mode).
+ * The students are spread over a pool of worker threads which share the CatalogSource
+ * and a RequirementsCache, so each major is loaded once for the whole batch. Every
+ * student gets their own report file so the output does not depend on how the work was
+ * scheduled: a file holding one student is reported to <file name>.audit and the
+ * students of a file holding many to <student id>.audit (.json or .csv instead of .audit
+ * with --format). If two students would get the same report (eg. a/s.txt and b/s.txt, or
+ * two files holding student 1) nothing is audited, so no report is silently overwritten.
+ * Prints the throughput once all are done.
  */
-void populateCourseData(std::vector<Course> &courses, std::unique_ptr<sql::Connection> &con) {
-  std::unique_ptr< sql::ResultSet > res;
-  std::unique_ptr< sql::Statement > stmt(con->createStatement());
-  // iterate over the courses
-  for(auto it = courses.begin(); it != courses.end(); ++it) {
-    // extract the course num and listing from the courseNum string
-    // find where the number begins
-    std::string courseNum = (*it).getCourseNum();
-    int num;
-    std::string listing;
-    for(int i = 0; i < courseNum.length(); ++i) {
-      if(std::isdigit(courseNum[i]) != 0) {
-        listing = courseNum.substr(0, i-2);
-        num = atoi(courseNum.substr(i-2, courseNum.length()).c_str());	
-      } 
-    } 
-    // create a string for the exicute statement
-    std::string exe("CALL getCourseData(");
-    exe.append(std::to_string(num));
-    exe.append(", '");
-    exe.append(listing);
-    exe.append("')");
-    
-    stmt->execute(exe);
-    do {
-      res.reset(stmt->getResultSet());
-      // get the course name and credits
-      while(res->next()) {
-        std::string result = res->getString(1);
-        (*it).setName(result);
-        int result_i = res->getInt(2);
-        (*it).setCredits(result_i);
+int runBatch(int argc, char* argv[]) {
+  unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::string outDir(".");
+  bool printStats = false, makePlans = false, listEligible = false;
+  int creditCap = GraduationPlanner::DEFAULT_CREDIT_CAP;
+  int electiveLimit = 0, electivePage = 0;
+  ChoiceOrder electiveOrder = CHOICES_LISTED;
+  OverlapRules overlap;
+  size_t auditCacheSize = AuditCache::DEFAULT_MAX_BYTES;
+  ReportFormat format = REPORT_TEXT;
+  std::string snapshotFile, fixtureFile, dbConfig, metricsFile;
+  std::vector<std::string> files;
+  for(int i = 2; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--snapshot" && i + 1 < argc) {
+      snapshotFile = argv[++i];
+    } else if(arg == "--fixture" && i + 1 < argc) {
+      fixtureFile = argv[++i];
+    } else if(arg == "--format" && i + 1 < argc) {
+      if(!ReportWriter::parseFormat(argv[++i], format)) {
+        printUsage();
+        return 1;
+      }
+    } else if(arg == "--threads" && i + 1 < argc) {
+      numThreads = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--out" && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if(arg == "--db-config" && i + 1 < argc) {
+      dbConfig = argv[++i];
+    } else if(arg == "--stats") {
+      printStats = true;
+    } else if(arg == "--plan") {
+      makePlans = true;
+    } else if(arg == "--eligible") {
+      listEligible = true;
+    } else if(arg == "--credit-cap" && i + 1 < argc) {
+      makePlans = true;
+      creditCap = atoi(argv[++i]);
+    } else if(arg == "--max-shared" && i + 1 < argc) {
+      overlap.maxShared = atoi(argv[++i]);
+    } else if(arg == "--exclusive" && i + 1 < argc) {
+      overlap.exclusive.insert(argv[++i]);
+    } else if(arg == "--audit-cache" && i + 1 < argc) {
+      auditCacheSize = (size_t)std::max(0, atoi(argv[++i])) << 20;
+    } else if(arg == "--elective-limit" && i + 1 < argc) {
+      electiveLimit = std::max(0, atoi(argv[++i]));
+    } else if(arg == "--elective-page" && i + 1 < argc) {
+      electivePage = std::max(0, atoi(argv[++i]));
+    } else if(arg == "--elective-order" && i + 1 < argc) {
+      if(!ChoicePager::parseOrder(argv[++i], electiveOrder)) {
+        printUsage();
+        return 1;
+      }
+    } else if(arg == "--metrics" && i + 1 < argc) {
+      metricsFile = argv[++i];
+    } else if(!collectStudentFiles(arg, files)) {
+      return 1;
+    }
+  }
+  if(files.empty()) {
+    printUsage();
+    return 1;
+  }
+  Metrics::enable(printStats || !metricsFile.empty());
+  // audit in a fixed order and only once per file
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+
+  std::vector<BatchJob> jobs;
+  std::map<std::string, std::string> reportedFrom;// report file -> the student written to it
+  for(auto it = files.begin(); it != files.end(); ++it) {
+    std::vector<Student> students;
+    if(!readStudents(*it, students)) {
+      return 1;
+    }
+    for(auto s = students.begin(); s != students.end(); ++s) {
+      BatchJob job;
+      job.student = *s;
+      job.report = (students.size() == 1) ? reportPath(outDir, *it, ReportWriter::extension(format))
+                                          : outDir + "/" + (*s).getId() + ReportWriter::extension(format);
+      std::string from = (students.size() == 1) ? *it : "student " + (*s).getId() + " of " + *it;
+      auto clash = reportedFrom.insert(std::make_pair(job.report, from));
+      if(!clash.second) {
+        std::cerr << "Both " << clash.first->second << " and " << from << " would be reported to "
+                  << job.report << " - rename one of them" << std::endl;
+        return 1;
+      }
+      jobs.push_back(job);
+    }
+  }
+  if(jobs.empty()) {
+    std::cerr << "No students found" << std::endl;
+    return 1;
+  }
+  numThreads = std::min<unsigned int>(numThreads, jobs.size());
+
+  CourseCatalog &catalog = CourseCatalog::instance();
+  RequirementsCache requirements;
+  // the audits, the planner and the prerequisites (and their indexes) of each major are shared by the
+  // workers too
+  MultiMajorAudit multiMajor(overlap);
+  AuditCache auditCache(auditCacheSize);
+  GraduationPlanner planner(creditCap);
+  PrerequisiteCache prerequisites;
+  // the workers share one source (with one connection per worker unless the config says otherwise)
+  // and the catalog version is checked once for the whole batch
+  std::unique_ptr<CatalogSource> source = openCatalogSource(snapshotFile, fixtureFile, dbConfig, numThreads);
+  if(!source) {
+    return 1;
+  }
+  // plans and eligible courses use the data of every choice
+  ChoicePager pager(electiveLimit, electiveOrder, electivePage);
+  source->setLazyElectives(pager.allowsLazyPools() && !makePlans && !listEligible);
+  if((makePlans || listEligible) && !source->providesPrerequisites()) {
+    std::cerr << "The catalog does not record prerequisites - --plan and --eligible need them" << std::endl;
+    return 1;
+  }
+
+  std::atomic<size_t> next(0), audited(0), failed(0);
+  auto worker = [&]() {
+    for(size_t i = next++; i < jobs.size(); i = next++) {
+      std::ostringstream report;
+      bool ok = true;
+      try {
+        Student &s = jobs[i].student;
+        // the requirements of each major are only loaded by the first student with that major
+        std::vector<std::string> majors = s.getMajors();
+        std::vector<std::shared_ptr<const RequirementProgram> > programs;
+        for(auto m = majors.begin(); m != majors.end(); ++m) {
+          programs.push_back(findProgram(*m, requirements, *source));
+        }
+        std::vector<AuditResult> results = auditMajors(s, majors, programs, multiMajor, auditCache);
+        for(size_t r = 0; r < results.size(); ++r) {
+          AuditResult &result = results[r];
+          if(!result.majorFound) {
+            ok = false;// reports the unknown major
+            continue;
+          }
+          const std::shared_ptr<const MajorRequirements> &req = programs[r]->getRequirements();
+          if(listEligible) {
+            result.eligible = prerequisites.getIndex(*source, req)->eligibleCourses(result);
+            result.eligibleListed = true;
+          }
+          if(makePlans) {
+            result.plan = planner.plan(result, *prerequisites.get(*source, req));
+          }
+          pager.apply(result, *req, *source);
+        }
+        ReportWriter writer(report, format);
+        for(auto r = results.begin(); r != results.end(); ++r) {
+          writer.write(*r);
+        }
+      }
+      catch(sql::SQLException &e) {
+        report << "# ERR: " << e.what();
+        report << " (MySQL error code: " << e.getErrorCode();
+        report << ", SQLState: " << e.getSQLState() << " )" << std::endl;
+        ok = false;
+      }
+      catch(std::runtime_error &e) {
+        report << "# ERR: " << e.what() << std::endl;// no connection could be made
+        ok = false;
+      }
+      std::ofstream outFile(jobs[i].report);
+      outFile << report.str();
+      if(!outFile) {
+        std::cerr << "Could not write " << jobs[i].report << std::endl;
+        ok = false;
       }
-    } while(stmt->getMoreResults());
+      ++(ok ? audited : failed);
+    }
+  };
 
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for(unsigned int i = 0; i < numThreads; ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  for(auto it = threads.begin(); it != threads.end(); ++it) {
+    (*it).join();
   }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  size_t skipped = jobs.size() - audited - failed;
+  std::cerr << "Audited " << audited << " of " << jobs.size() << " students in " << seconds
+            << " s (" << (seconds > 0 ? audited / seconds : 0) << " students/sec) using "
+            << numThreads << " threads" << std::endl;
+  if(failed > 0 || skipped > 0) {
+    std::cerr << failed << " audits failed, " << skipped << " students were not audited" << std::endl;
+  }
+  if(printStats) {
+    catalog.printStats(std::cerr);
+    requirements.printStats(std::cerr);
+    auditCache.printStats(std::cerr);
+    source->printStats(std::cerr);
+    Metrics::instance().printSummary(std::cerr);
+  }
+  if(!writeMetrics(metricsFile)) {
+    return 1;
+  }
+  return (failed > 0 || skipped > 0) ? 1 : 0;
 }
 
-// Removes the intersect of the 2 lists from the required vector
-void updateRequired(std::vector<Course> &required, std::vector<Course> &completed) {
-  for(auto it = required.begin(); it != required.end(); ++it) {
-    for(auto tt = completed.begin(); tt != completed.end();  ++tt) {
-      if((*it) == (*tt)) {
-        required.erase(it);
- 	--it;// decrement due to remove
+/*
+ * Prints how many students of a cohort still need each course (--demand mode), counted
+ * by kind of need and year (see DemandTable).
+ * The students of every file given are read into a StudentStore and audited by a pool of
+ * threads. The requirements of each major are found once before the threads start, so
+ * the threads only read shared data. A student with several majors is audited against
+ * each through the MultiMajorAudit and counted once. Each thread counts its students into a
+ * table of its own, and the tables are then merged in pairs in parallel, so no lock is
+ * taken per student.
+ */
+int runDemand(int argc, char* argv[]) {
+  unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  bool printStats = false;
+  ReportFormat format = REPORT_TEXT;
+  std::string snapshotFile, fixtureFile, dbConfig, metricsFile;
+  OverlapRules overlap;
+  std::vector<std::string> files;
+  for(int i = 2; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--snapshot" && i + 1 < argc) {
+      snapshotFile = argv[++i];
+    } else if(arg == "--fixture" && i + 1 < argc) {
+      fixtureFile = argv[++i];
+    } else if(arg == "--format" && i + 1 < argc) {
+      if(!ReportWriter::parseFormat(argv[++i], format)) {
+        printUsage();
+        return 1;
+      }
+    } else if(arg == "--threads" && i + 1 < argc) {
+      numThreads = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--db-config" && i + 1 < argc) {
+      dbConfig = argv[++i];
+    } else if(arg == "--max-shared" && i + 1 < argc) {
+      overlap.maxShared = atoi(argv[++i]);
+    } else if(arg == "--exclusive" && i + 1 < argc) {
+      overlap.exclusive.insert(argv[++i]);
+    } else if(arg == "--stats") {
+      printStats = true;
+    } else if(arg == "--metrics" && i + 1 < argc) {
+      metricsFile = argv[++i];
+    } else if(!collectStudentFiles(arg, files)) {
+      return 1;
+    }
+  }
+  if(files.empty()) {
+    printUsage();
+    return 1;
+  }
+  Metrics::enable(printStats || !metricsFile.empty());
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+
+  StudentStore students;
+  {
+    static Histogram &parseTime = Metrics::stage("parse");
+    ScopedTimer timer(parseTime);
+    for(auto it = files.begin(); it != files.end(); ++it) {
+      std::string error;
+      if(!students.load(*it, error)) {
+        std::cerr << "# ERR: " << error << std::endl;
+        return 1;
+      }
+    }
+  }
+  if(students.empty()) {
+    std::cerr << "No students found" << std::endl;
+    return 1;
+  }
+  numThreads = std::min<unsigned int>(numThreads, students.size());
+
+  RequirementsCache requirements;
+  std::unique_ptr<CatalogSource> source = openCatalogSource(snapshotFile, fixtureFile, dbConfig, numThreads);
+  if(!source) {
+    return 1;
+  }
+  MultiMajorAudit multiMajor(overlap);
+  // the compiled requirements of every major, by the store's major index (null if the major does not exist)
+  std::vector<std::shared_ptr<const RequirementProgram> > programs;
+  try {
+    for(auto it = students.getMajors().begin(); it != students.getMajors().end(); ++it) {
+      programs.push_back(findProgram(*it, requirements, *source));
+    }
+  }
+  catch(sql::SQLException &e) {
+    std::cerr << "# ERR: " << e.what() << " (MySQL error code: " << e.getErrorCode() << ")" << std::endl;
+    return 1;
+  }
+  catch(std::runtime_error &e) {
+    std::cerr << "# ERR: " << e.what() << std::endl;
+    return 1;
+  }
+
+  // the students are handed out in chunks so the threads rarely touch the shared counter
+  const size_t CHUNK_SIZE = 64;
+  std::vector<DemandTable> tables(numThreads);
+  std::atomic<size_t> next(0);
+  auto worker = [&](DemandTable &table) {
+    for(size_t begin = next.fetch_add(CHUNK_SIZE); begin < students.size(); begin = next.fetch_add(CHUNK_SIZE)) {
+      size_t end = std::min(students.size(), begin + CHUNK_SIZE);
+      for(size_t i = begin; i < end; ++i) {
+        StudentView s = students[i];
+        const std::vector<uint32_t> &listed = s.getMajorIndexes();
+        if(listed.size() == 1) {
+          const RequirementProgram *program = programs[listed[0]].get();
+          table.add(program ? s.audit(*program) : s.newResult());
+          continue;
+        }
+        std::vector<std::string> majors;
+        std::vector<std::shared_ptr<const RequirementProgram> > found;
+        for(auto m = listed.begin(); m != listed.end(); ++m) {
+          majors.push_back(students.getMajors()[*m]);
+          found.push_back(programs[*m]);
+        }
+        table.add(multiMajor.audit(s.newResult(), majors, found));
       }
     }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for(unsigned int i = 0; i < numThreads; ++i) {
+    threads.push_back(std::thread(worker, std::ref(tables[i])));
+  }
+  for(auto it = threads.begin(); it != threads.end(); ++it) {
+    (*it).join();
+  }
+  // merge the tables in pairs: table i takes in table i + step, for ever larger steps
+  for(size_t step = 1; step < tables.size(); step *= 2) {
+    threads.clear();
+    for(size_t i = 0; i + step < tables.size(); i += 2 * step) {
+      threads.push_back(std::thread([&tables, i, step]() { tables[i].merge(tables[i + step]); }));
+    }
+    for(auto it = threads.begin(); it != threads.end(); ++it) {
+      (*it).join();
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const DemandTable &demand = tables[0];
+  demand.write(std::cout, format);
+  std::cerr << "Counted " << demand.getStudents() + demand.getUnknownMajor() << " of " << students.size()
+            << " students in " << seconds << " s using " << numThreads << " threads" << std::endl;
+  if(printStats) {
+    std::cerr << "Student store: " << students.size() << " students, " << students.getNumCourses()
+              << " courses, " << students.getMajors().size() << " majors in " << students.memoryUsage()
+              << " bytes" << std::endl;
+    CourseCatalog::instance().printStats(std::cerr);
+    requirements.printStats(std::cerr);
+    source->printStats(std::cerr);
+    Metrics::instance().printSummary(std::cerr);
+  }
+  if(!writeMetrics(metricsFile)) {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Runs the audit server (--serve mode): listens on a Unix domain socket and answers every
+ * request with the audits of the students in it (see answerRequest).
+ * The catalog source (and its connections), the course catalog and the requirements of
+ * every major asked about stay warm between requests. The catalog version is checked at most once a minute so
+ * catalog edits still reach the caches.
+ * With --stats or --metrics FILE the metrics are recorded; a "#metrics" request returns them
+ * in the Prometheus text format and they are written to FILE when the server stops.
+ */
+int runServer(int argc, char* argv[]) {
+  if(argc < 3) {
+    printUsage();
+    return 1;
+  }
+  std::string socketPath(argv[2]);
+  unsigned int numWorkers = std::max(1u, std::thread::hardware_concurrency());
+  size_t maxQueue = 64;
+  size_t auditCacheSize = AuditCache::DEFAULT_MAX_BYTES;
+  size_t maxKept = AuditStore::DEFAULT_MAX_AUDITS;
+  bool printStats = false;
+  ReportFormat format = REPORT_TEXT;
+  std::string snapshotFile, fixtureFile, dbConfig, metricsFile;
+  OverlapRules overlap;
+  for(int i = 3; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--workers" && i + 1 < argc) {
+      numWorkers = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--queue" && i + 1 < argc) {
+      maxQueue = std::max(1, atoi(argv[++i]));
+    } else if(arg == "--audit-cache" && i + 1 < argc) {
+      auditCacheSize = (size_t)std::max(0, atoi(argv[++i])) << 20;
+    } else if(arg == "--audit-store" && i + 1 < argc) {
+      maxKept = std::max(0, atoi(argv[++i]));
+    } else if(arg == "--snapshot" && i + 1 < argc) {
+      snapshotFile = argv[++i];
+    } else if(arg == "--fixture" && i + 1 < argc) {
+      fixtureFile = argv[++i];
+    } else if(arg == "--db-config" && i + 1 < argc) {
+      dbConfig = argv[++i];
+    } else if(arg == "--format" && i + 1 < argc) {
+      if(!ReportWriter::parseFormat(argv[++i], format)) {
+        printUsage();
+        return 1;
+      }
+    } else if(arg == "--max-shared" && i + 1 < argc) {
+      overlap.maxShared = atoi(argv[++i]);
+    } else if(arg == "--exclusive" && i + 1 < argc) {
+      overlap.exclusive.insert(argv[++i]);
+    } else if(arg == "--stats") {
+      printStats = true;
+    } else if(arg == "--metrics" && i + 1 < argc) {
+      metricsFile = argv[++i];
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  Metrics::enable(printStats || !metricsFile.empty());
+
+  CourseCatalog &catalog = CourseCatalog::instance();
+  RequirementsCache requirements;
+  // opening the source connects to the database so a bad config is found before serving
+  std::unique_ptr<CatalogSource> source = openCatalogSource(snapshotFile, fixtureFile, dbConfig, numWorkers);
+  if(!source) {
+    return 1;
+  }
+  requirements.checkVersion(catalog.getVersion());
+  MultiMajorAudit multiMajor(overlap);
+  AuditCache auditCache(auditCacheSize);// shared by students who have taken the same courses
+  auditCache.checkVersion(catalog.getVersion());
+  AuditStore audits(maxKept);// the audits answered last, so later requests can send only what changed
+  audits.checkVersion(catalog.getVersion());
+
+  typedef std::chrono::steady_clock Clock;
+  std::mutex versionLock;
+  Clock::time_point lastVersionCheck = Clock::now();
+  AuditServer server(socketPath, numWorkers, maxQueue, [&](const std::string &request) {
+    {
+      // one worker at a time checks whether the catalog has changed
+      std::unique_lock<std::mutex> guard(versionLock, std::try_to_lock);
+      if(guard.owns_lock() && Clock::now() - lastVersionCheck > std::chrono::minutes(1)) {
+        lastVersionCheck = Clock::now();
+        try {
+          std::string version = source->getCatalogVersion();
+          catalog.checkVersion(version);
+          requirements.checkVersion(version);
+          auditCache.checkVersion(version);
+          audits.checkVersion(version);
+        }
+        catch(std::runtime_error &e) {
+          // no connection could be made - check again next time
+        }
+      }
+    }
+    return answerRequest(request, format, requirements, *source, multiMajor, auditCache, audits);
+  });
+  std::string error;
+  if(!server.listen(error)) {
+    std::cerr << "# ERR: " << error << std::endl;
+    return 1;
+  }
+  std::cerr << "Serving audits on " << socketPath << " with " << numWorkers << " workers" << std::endl;
+  server.run();
+
+  if(printStats) {
+    server.printStats(std::cerr);
+    catalog.printStats(std::cerr);
+    requirements.printStats(std::cerr);
+    auditCache.printStats(std::cerr);
+    audits.printStats(std::cerr);
+    source->printStats(std::cerr);
+    Metrics::instance().printSummary(std::cerr);
+  }
+  return writeMetrics(metricsFile) ? 0 : 1;
+}
+
+/*
+ * Audits the students in one server request and returns the reports.
+ * The request holds transcripts in any layout TranscriptParser accepts. It may start with
+ * option lines beginning with '#'; "#format json" (or text, csv) picks the report format.
+ * A "#metrics" request returns the metrics in the Prometheus text format instead.
+ * A student with several majors (separated by ';') gets one report per major, like the
+ * other modes. The audit of every student with one major is kept in the store, so once
+ * such a student has been audited a "#delta" request can send only the courses that
+ * changed (see answerDelta).
+ * Problems are reported in the response as lines starting with "# ERR: ".
+ */
+std::string answerRequest(const std::string &request, ReportFormat format, RequirementsCache &cache,
+                          CatalogSource &source, const MultiMajorAudit &multiMajor, AuditCache &auditCache,
+                          AuditStore &store) {
+  // read the option lines
+  size_t begin = 0, lineNum = 0;
+  while(begin < request.size() && request[begin] == '#') {
+    size_t end = request.find('\n', begin);
+    if(end == std::string::npos) {
+      end = request.size();
+    }
+    std::istringstream option(request.substr(begin + 1, end - begin - 1));
+    std::string name, value;
+    option >> name >> value;
+    if(name == "metrics") {
+      if(!Metrics::enabled()) {
+        return "# ERR: metrics are off - start the server with --stats or --metrics\n";
+      }
+      std::ostringstream metrics;
+      Metrics::instance().writePrometheus(metrics);
+      return metrics.str();
+    }
+    if(name == "delta") {
+      return answerDelta(request, std::min(end + 1, request.size()), format, store);
+    }
+    if(name != "format" || !ReportWriter::parseFormat(value, format)) {
+      return "# ERR: unknown option line \"" + request.substr(begin, end - begin) + "\"\n";
+    }
+    begin = end + 1;
+    ++lineNum;
+  }
+
+  std::vector<Student> students;
+  try {
+    static Histogram &parseTime = Metrics::stage("parse");
+    ScopedTimer timer(parseTime);
+    begin = std::min(begin, request.size());
+    TranscriptParser parser(request.data() + begin, request.size() - begin, "request", lineNum + 1);
+    parser.parse([&students](const TranscriptRecord &record) {
+      students.push_back(Student(record));
+    });
+  }
+  catch(TranscriptError &e) {
+    return std::string("# ERR: ") + e.what() + "\n";
+  }
+
+  std::ostringstream response;
+  ReportWriter writer(response, format);
+  for(auto it = students.begin(); it != students.end(); ++it) {
+    try {
+      std::vector<std::string> majors = (*it).getMajors();
+      std::vector<std::shared_ptr<const RequirementProgram> > programs;
+      for(auto m = majors.begin(); m != majors.end(); ++m) {
+        programs.push_back(findProgram(*m, cache, source));
+      }
+      std::vector<AuditResult> results = auditMajors(*it, majors, programs, multiMajor, auditCache);
+      if(programs.size() == 1 && programs[0]) {
+        store.keep(results[0], programs[0]);
+      } else {
+        store.forget((*it).getId());// the audits of several majors are not kept
+      }
+      for(auto r = results.begin(); r != results.end(); ++r) {
+        writer.write(*r);
+      }
+    }
+    catch(sql::SQLException &e) {
+      writer.flush();
+      response << "# ERR: " << e.what();
+      response << " (MySQL error code: " << e.getErrorCode();
+      response << ", SQLState: " << e.getSQLState() << " )" << std::endl;
+    }
+    catch(std::runtime_error &e) {
+      writer.flush();
+      response << "# ERR: " << e.what() << std::endl;// no connection could be made
+    }
+  }
+  writer.flush();
+  return response.str();
+}
+
+/*
+ * Answers a "#delta" request: the lines after the option lines (from begin) each name a
+ * student audited before and the courses added to (+) or removed from their transcript
+ *   id|+CS540,+CS545,-CS302
+ * The kept audits are updated and their reports returned. A student with no kept audit
+ * (never audited, or dropped because the catalog changed) is reported as an error so the
+ * client can send the whole transcript again.
+ */
+std::string answerDelta(const std::string &request, size_t begin, ReportFormat format, AuditStore &store) {
+  std::ostringstream response;
+  ReportWriter writer(response, format);
+  std::istringstream lines(request.substr(begin));
+  std::string line;
+  while(getline(lines, line)) {
+    if(line.empty()) {
+      continue;
+    }
+    std::string::size_type bar = line.find('|');
+    std::string id = line.substr(0, bar);
+    std::vector<CourseKey> added, removed;
+    std::istringstream changes(bar == std::string::npos ? "" : line.substr(bar + 1));
+    std::string change;
+    bool valid = bar != std::string::npos;
+    while(valid && getline(changes, change, ',')) {
+      CourseKey key = CourseKey::parse(change.substr(std::min<size_t>(1, change.size())));
+      valid = key.isValid() && (change[0] == '+' || change[0] == '-');
+      (change[0] == '+' ? added : removed).push_back(key);
+    }
+    AuditResult result;
+    if(!valid) {
+      writer.flush();
+      response << "# ERR: bad delta line \"" << line << "\"" << std::endl;
+    } else if(!store.apply(id, added, removed, result)) {
+      writer.flush();
+      response << "# ERR: no audit of student " << id << " is kept - send the whole transcript" << std::endl;
+    } else {
+      writer.write(result);
+    }
+  }
+  writer.flush();
+  return response.str();
+}
+
+// prints a vector of strings to cout
+void printStringVector(const std::vector<std::string> print_me) {
+  for(auto it = print_me.begin(); it != print_me.end(); ++it) {
+    std::cout << *it << std::endl;
+  }
+}
+
+// prints the data of each course in the vector
+void printCourses(std::vector<Course> courses, std::ostream &out) {
+  for(auto it = courses.begin(); it != courses.end(); ++it) {
+    out << "-";
+    (*it).printData(out);
   }
 }
@@ -0,0 +1,259 @@
+///////////////////////////////////////////////////////////////////////////////
+// File Name:      course_guide_test.cpp
+//
+// Author:         Jacob Siebert, Matt Patek
+// CS email:       siebert@cs.wisc.edu, mpatek@cs.wisc.edu
+//
+// Description:    Runs a built course_guide through each of its modes on the
+//                 catalog and students in golden/ and compares what it prints
+//                 with the golden output stored there. Every case is run from
+//                 the fixture and again from a snapshot exported from it, so
+//                 the two catalog sources must agree.
+///////////////////////////////////////////////////////////////////////////////
+
+// Note: Must use the following tags to compile:
+//       -std=c++17
+//       (no MySQL connector needed)
+
+// include standard c++ libs
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+// include posix headers for temporary directories and reading directories
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+
+// one run of course_guide and the golden file its output is compared with
+struct TestCase {
+  std::string name;// the golden file is <name>.out
+  std::vector<std::string> args;// "{catalog}" becomes the catalog options, "{students}" the students file
+                                 // and "{out}" a directory for reports
+  bool bothSources;// false if the output depends on the catalog source (run from the fixture only)
+};
+
+// define funcitons
+void printUsage();
+std::vector<TestCase> makeCases();
+std::string shellQuote(const std::string &s);
+bool runCommand(const std::vector<std::string> &args, std::string &output);
+std::string readFile(const std::string &path);
+bool readReports(const std::string &dir, std::string &output);
+bool runCase(const TestCase &test, const std::string &binary, const std::vector<std::string> &catalog,
+             const std::string &students, const std::string &workDir, std::string &output);
+
+int main(int argc, char* argv[]) {
+  bool update = false;
+  std::string binary, goldenDir("golden");
+  std::vector<std::string> positional;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--update") {
+      update = true;
+    } else if(arg[0] == '-') {
+      printUsage();
+      return 1;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if(positional.empty() || positional.size() > 2) {
+    printUsage();
+    return 1;
+  }
+  binary = positional[0];
+  if(positional.size() == 2) {
+    goldenDir = positional[1];
+  }
+
+  char workTemplate[] = "/tmp/course_guide_test.XXXXXX";
+  if(mkdtemp(workTemplate) == NULL) {
+    std::cerr << "Could not make a temporary directory" << std::endl;
+    return 1;
+  }
+  std::string workDir(workTemplate);
+  std::string fixture = goldenDir + "/catalog.fixture";
+  std::string snapshot = workDir + "/catalog.snap";
+
+  // the snapshot holds every major of the fixture
+  std::string exported;
+  if(!runCommand({ binary, "--export-snapshot", snapshot, "--fixture", fixture, "Computer Science", "Mathematics" },
+                 exported) || exported != "exit status 0\n") {
+    std::cerr << "Could not export " << fixture << " to " << snapshot << std::endl;
+    return 1;
+  }
+  struct Source {
+    std::string name;
+    std::vector<std::string> catalog;
+  };
+  std::vector<Source> sources = { { "fixture", { "--fixture", fixture } }, { "snapshot", { "--snapshot", snapshot } } };
+
+  int failed = 0, passed = 0;
+  std::vector<TestCase> cases = makeCases();
+  for(auto test = cases.begin(); test != cases.end(); ++test) {
+    std::string golden = goldenDir + "/" + test->name + ".out";
+    for(auto source = sources.begin(); source != sources.end(); ++source) {
+      if(source != sources.begin() && !test->bothSources) {
+        continue;
+      }
+      std::string output;
+      if(!runCase(*test, binary, source->catalog, goldenDir + "/students.txt", workDir, output)) {
+        std::cout << "FAIL " << test->name << " (" << source->name << "): could not run " << binary << std::endl;
+        ++failed;
+        continue;
+      }
+      // the fixture run writes the golden file when updating and every run is compared with it
+      if(update && source == sources.begin()) {
+        std::ofstream out(golden, std::ios::binary | std::ios::trunc);
+        out << output;
+        if(!out) {
+          std::cerr << "Could not write " << golden << std::endl;
+          return 1;
+        }
+      }
+      if(output == readFile(golden)) {
+        ++passed;
+        continue;
+      }
+      std::string actual = workDir + "/" + test->name + "." + source->name + ".out";
+      std::ofstream(actual, std::ios::binary) << output;
+      std::cout << "FAIL " << test->name << " (" << source->name << "): diff " << golden << " " << actual << std::endl;
+      ++failed;
+    }
+  }
+  std::cout << passed << " passed, " << failed << " failed" << std::endl;
+  if(failed > 0) {
+    return 1;// the work directory is kept for the diffs
+  }
+  std::string clean = "rm -rf " + shellQuote(workDir);
+  return (std::system(clean.c_str()) == 0) ? 0 : 1;
+}
+
+void printUsage() {
+  std::cout << "Usage ./course_guide_test [--update] <path to course_guide> [golden directory]" << std::endl
+            << "       --update rewrites the golden output from the fixture before comparing" << std::endl;
+}
+
+/*
+ * The runs that are checked: one per report format and mode, on the students in
+ * golden/students.txt (one of them with a major the catalog does not have).
+ */
+std::vector<TestCase> makeCases() {
+  std::vector<TestCase> cases;
+  cases.push_back({ "text", { "{catalog}", "{students}" }, true });
+  cases.push_back({ "json", { "--format", "json", "{catalog}", "{students}" }, true });
+  cases.push_back({ "csv", { "--format", "csv", "{catalog}", "{students}" }, true });
+  cases.push_back({ "plan", { "--plan", "--eligible", "{catalog}", "{students}" }, true });
+  cases.push_back({ "plan_cap", { "--credit-cap", "7", "--format", "json", "{catalog}", "{students}" }, true });
+  cases.push_back({ "shared", { "--max-shared", "1", "--exclusive", "Calculus", "{catalog}", "{students}" }, true });
+  cases.push_back({ "paged_credits", { "--elective-limit", "2", "--elective-order", "credits", "--format", "json",
+                                       "{catalog}", "{students}" }, true });
+  // a fixture loads the pools lazily when paging, a snapshot always has the data of every choice
+  cases.push_back({ "paged", { "--elective-limit", "2", "--elective-page", "1", "--elective-order", "number",
+                               "--format", "csv", "{catalog}", "{students}" }, false });
+  cases.push_back({ "batch", { "--batch", "--threads", "2", "--out", "{out}", "{catalog}", "{students}" }, true });
+  cases.push_back({ "demand", { "--demand", "--format", "csv", "{catalog}", "{students}" }, true });
+  return cases;
+}
+
+// s in single quotes for /bin/sh
+std::string shellQuote(const std::string &s) {
+  std::string quoted("'");
+  for(auto it = s.begin(); it != s.end(); ++it) {
+    if(*it == '\'') {
+      quoted.append("'\\''");
+    } else {
+      quoted.push_back(*it);
+    }
+  }
+  quoted.push_back('\'');
+  return quoted;
+}
+
+/*
+ * Runs a command and collects what it prints on stdout (stderr is dropped).
+ * Returns false if the command could not be run at all; its exit status ends the output.
+ */
+bool runCommand(const std::vector<std::string> &args, std::string &output) {
+  std::string command;
+  for(auto it = args.begin(); it != args.end(); ++it) {
+    command.append(shellQuote(*it) + " ");
+  }
+  command.append("2>/dev/null");
+  FILE *pipe = popen(command.c_str(), "r");
+  if(pipe == NULL) {
+    return false;
+  }
+  char buffer[4096];
+  size_t read;
+  while((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+    output.append(buffer, read);
+  }
+  int status = pclose(pipe);
+  if(status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+    return false;
+  }
+  output.append("exit status " + std::to_string(WEXITSTATUS(status)) + "\n");
+  return true;
+}
+
+// the contents of a file (empty if it can not be read)
+std::string readFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+// appends every report file in dir, in name order, each under a line naming it
+bool readReports(const std::string &dir, std::string &output) {
+  DIR *d = opendir(dir.c_str());
+  if(d == NULL) {
+    return false;
+  }
+  std::vector<std::string> names;
+  while(struct dirent *entry = readdir(d)) {
+    std::string name(entry->d_name);
+    if(name != "." && name != "..") {
+      names.push_back(name);
+    }
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  for(auto it = names.begin(); it != names.end(); ++it) {
+    output.append("== " + *it + " ==\n" + readFile(dir + "/" + *it));
+  }
+  return true;
+}
+
+/*
+ * Runs one case on the students file with the given catalog options.
+ * The reports of a batch are read back from its output directory.
+ */
+bool runCase(const TestCase &test, const std::string &binary, const std::vector<std::string> &catalog,
+             const std::string &students, const std::string &workDir, std::string &output) {
+  static int runs = 0;
+  std::string outDir = workDir + "/out" + std::to_string(runs++);
+  if(mkdir(outDir.c_str(), 0700) != 0) {
+    return false;
+  }
+  std::vector<std::string> args(1, binary);
+  for(auto it = test.args.begin(); it != test.args.end(); ++it) {
+    if(*it == "{catalog}") {
+      args.insert(args.end(), catalog.begin(), catalog.end());
+    } else if(*it == "{students}") {
+      args.push_back(students);
+    } else if(*it == "{out}") {
+      args.push_back(outDir);
+    } else {
+      args.push_back(*it);
+    }
+  }
+  return runCommand(args, output) && readReports(outDir, output);
+}